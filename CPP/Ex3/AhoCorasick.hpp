@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "HashMap.hpp"
+
+
+#ifndef EX3_AHOCORASICK_H
+#define EX3_AHOCORASICK_H
+
+/**
+ * An Aho-Corasick automaton matching a set of weighted phrases, compiled once, which finds the
+ * occurrences of all of them in a single pass over a text: O(text length + occurrences), whatever
+ * the number of phrases, where searching every phrase on its own costs O(phrases * text length).
+ * Phrases are normalized (see normalize()), and phrases equal once normalized share a pattern whose
+ * weight is the sum of their weights. Bytes which appear in no pattern share one byte class. The
+ * trie of the patterns keeps only its edges, sorted by class, and a text follows failure links
+ * where a state has no edge for a byte, so the automaton takes O(states) memory whatever the
+ * alphabet. While the complete DFA (a transition for every state and byte class) fits in
+ * MAX_DENSE_TRANSITIONS, it is built too, and reading a byte is one table lookup. A state whose
+ * path ends a pattern, or has a suffix ending one, reports those patterns through its dictionary
+ * link.
+ * Occurrences of a pattern are counted like repeated std::string::find calls resuming after each
+ * match: leftmost first, and without overlapping each other (but overlapping other patterns).
+ */
+class AhoCorasick
+{
+    static constexpr int ROOT = 0;
+    static constexpr int CLASS_BITS = 9; // bits of a byte class in a key of the trie's edges
+    static constexpr size_t MAX_DENSE_TRANSITIONS = (size_t) 1 << 22; // 16MB of transitions
+
+    std::vector<std::string> _patterns; // normalized phrases
+    std::vector<int> _weights; // weight of every pattern
+    uint16_t _classOf[256]; // byte class of every byte; 0 for bytes of no pattern
+    int _classCount;
+    std::vector<int> _edgeStart; // edges of every state: [_edgeStart[state], _edgeStart[state + 1])
+    std::vector<uint16_t> _edgeClass; // class of every edge, sorted within a state
+    std::vector<int> _edgeTarget; // child state of every edge
+    std::vector<int> _fail; // longest proper suffix state of every state
+    std::vector<int> _rootNext; // transition of the root for every class
+    std::vector<int> _next; // _next[state * _classCount + class]: complete DFA, or empty
+    std::vector<int> _output; // pattern ending at every state, or -1
+    std::vector<int> _dictionary; // nearest proper suffix state ending a pattern, or -1
+
+// ================================ PRIVATE HELPER METHODS =======================================
+
+    /**
+     * @param phrase phrase
+     * @return the phrase normalized, as it is matched.
+     */
+    static std::string _normalized(std::string_view phrase)
+    {
+        std::string normalized(phrase);
+        std::transform(normalized.begin(), normalized.end(), normalized.begin(), normalize);
+        return normalized;
+    }
+
+    /**
+     * @param state state
+     * @param c byte class
+     * @return child of state in the trie by an edge of class c, or -1.
+     */
+    int _child(int state, int c) const
+    {
+        auto first = _edgeClass.begin() + _edgeStart[state];
+        auto last = _edgeClass.begin() + _edgeStart[state + 1];
+        auto edge = std::lower_bound(first, last, (uint16_t) c);
+        return edge != last && *edge == c ? _edgeTarget[edge - _edgeClass.begin()] : -1;
+    }
+
+    /**
+     * @param state state
+     * @param c byte class
+     * @return transition of the automaton from state by class c: a lookup in the complete DFA if it
+     * was built, else the edge of the longest suffix of state (following failure links) having one.
+     */
+    int _step(int state, int c) const
+    {
+        if (!_next.empty())
+        {
+            return _next[(size_t) state * _classCount + c];
+        }
+        for (; state != ROOT; state = _fail[state])
+        {
+            int child = _child(state, c);
+            if (child != -1)
+            {
+                return child;
+            }
+        }
+        return _rootNext[c];
+    }
+
+    /**
+     * Builds the trie of the patterns, then its failure and dictionary links breadth first: the
+     * failure state of a child is the transition of its parent's failure state, which is shallower,
+     * so already linked. Rows of the complete DFA, when it fits, are filled in the same order: the
+     * missing transitions of a state are those of its failure state.
+     */
+    void _compile()
+    {
+        std::fill(std::begin(_classOf), std::end(_classOf), (uint16_t) 0);
+        _classCount = 1;
+        for (const std::string &pattern : _patterns)
+        {
+            for (unsigned char c : pattern)
+            {
+                if (_classOf[c] == 0)
+                {
+                    _classOf[c] = (uint16_t) _classCount++;
+                }
+            }
+        }
+        // the trie, as a parent and a class for every state but the root
+        HashMap<uint64_t, int> children; // child of every state << CLASS_BITS | class
+        std::vector<int> parent(1, -1);
+        std::vector<uint16_t> label(1, 0);
+        _output.assign(1, -1);
+        for (int p = 0; p < (int) _patterns.size(); ++p)
+        {
+            int state = ROOT;
+            for (unsigned char c : _patterns[p])
+            {
+                uint64_t key = (uint64_t) state << CLASS_BITS | _classOf[c];
+                auto edge = children.find(key);
+                if (edge == children.end())
+                {
+                    children.insert(key, (int) _output.size());
+                    parent.push_back(state);
+                    label.push_back(_classOf[c]);
+                    _output.push_back(-1);
+                    state = (int) _output.size() - 1;
+                }
+                else
+                {
+                    state = edge->second;
+                }
+            }
+            _output[state] = p;
+        }
+        children.clear();
+        // edges grouped by parent, then sorted by class
+        size_t states = _output.size();
+        _edgeStart.assign(states + 1, 0);
+        for (size_t state = 1; state < states; ++state)
+        {
+            ++_edgeStart[parent[state] + 1];
+        }
+        for (size_t state = 0; state < states; ++state)
+        {
+            _edgeStart[state + 1] += _edgeStart[state];
+        }
+        std::vector<std::pair<uint16_t, int>> edges(states - 1);
+        std::vector<int> filled(_edgeStart.begin(), _edgeStart.end() - 1);
+        for (size_t state = 1; state < states; ++state)
+        {
+            edges[filled[parent[state]]++] = {label[state], (int) state};
+        }
+        _edgeClass.resize(states - 1);
+        _edgeTarget.resize(states - 1);
+        for (size_t state = 0; state < states; ++state)
+        {
+            std::sort(edges.begin() + _edgeStart[state], edges.begin() + _edgeStart[state + 1]);
+        }
+        for (size_t e = 0; e < edges.size(); ++e)
+        {
+            _edgeClass[e] = edges[e].first;
+            _edgeTarget[e] = edges[e].second;
+        }
+        // failure and dictionary links, and the complete DFA if it fits
+        _rootNext.assign((size_t) _classCount, ROOT);
+        for (int e = _edgeStart[ROOT]; e < _edgeStart[ROOT + 1]; ++e)
+        {
+            _rootNext[_edgeClass[e]] = _edgeTarget[e];
+        }
+        _fail.assign(states, ROOT);
+        _dictionary.assign(states, -1);
+        bool dense = states * (size_t) _classCount <= MAX_DENSE_TRANSITIONS;
+        _next.clear();
+        std::vector<int> next(dense ? states * (size_t) _classCount : 0);
+        std::vector<int> queue(1, ROOT);
+        queue.reserve(states);
+        for (size_t head = 0; head < queue.size(); ++head)
+        {
+            int state = queue[head];
+            int f = _fail[state];
+            if (dense)
+            {
+                const int *fallback = state == ROOT ? _rootNext.data()
+                                                    : &next[(size_t) f * _classCount];
+                std::copy(fallback, fallback + _classCount, &next[(size_t) state * _classCount]);
+            }
+            for (int e = _edgeStart[state]; e < _edgeStart[state + 1]; ++e)
+            {
+                int child = _edgeTarget[e];
+                int c = _edgeClass[e];
+                if (dense)
+                {
+                    next[(size_t) state * _classCount + c] = child;
+                }
+                int childFail = state == ROOT ? ROOT
+                                              : dense ? next[(size_t) f * _classCount + c]
+                                                      : _step(f, c);
+                _fail[child] = childFail;
+                _dictionary[child] = _output[childFail] != -1 ? childFail
+                                                              : _dictionary[childFail];
+                queue.push_back(child);
+            }
+        }
+        if (dense)
+        {
+            // scans only use the DFA
+            _next = std::move(next);
+            std::vector<int>().swap(_edgeStart);
+            std::vector<uint16_t>().swap(_edgeClass);
+            std::vector<int>().swap(_edgeTarget);
+            std::vector<int>().swap(_fail);
+        }
+    }
+
+public:
+
+// ================================= CTORS, DTOR & RULE OF 5 =====================================
+
+    /**
+     * Constructor, compiles the automaton of a phrase table. Empty phrases are ignored.
+     * @param phrases pairs of a phrase (std::string or std::string_view) and its integer weight,
+     * e.g. a HashMap or a MappedHashMap
+     */
+    template<typename Map>
+    explicit AhoCorasick(const Map &phrases) : _classOf(), _classCount(1)
+    {
+        HashMap<std::string, int> ids; // pattern of every normalized phrase
+        for (const auto &p : phrases)
+        {
+            if (p.first.empty())
+            {
+                continue;
+            }
+            std::string pattern = _normalized(p.first);
+            auto it = ids.find(pattern);
+            if (it == ids.end())
+            {
+                ids.insert(pattern, (int) _patterns.size());
+                _patterns.push_back(std::move(pattern));
+                _weights.push_back(p.second);
+            }
+            else
+            {
+                _weights[it->second] += p.second;
+            }
+        }
+        _compile();
+    }
+
+// ======================================= API METHODS ===========================================
+
+    /**
+     * Normalizes a byte of a phrase or of a text, as they are matched: ASCII letters are lowered,
+     * like std::tolower in the "C" locale, and newlines and tabs become spaces. Selects with masks
+     * rather than branches, which would mispredict on mixed text.
+     * @param c byte
+     * @return the normalized byte.
+     */
+    static char normalize(char c)
+    {
+        unsigned char b = (unsigned char) c;
+        b |= (unsigned char) (((unsigned) (b - 'A') < 26) << 5);
+        unsigned char blank = (unsigned char) -((b == '\n') | (b == '\t')); // 0xFF for blanks
+        return (char) (b ^ (blank & (b ^ ' ')));
+    }
+
+    /**
+     * @return number of patterns, i.e. distinct normalized phrases.
+     */
+    int patternCount() const
+    { return (int) _patterns.size(); }
+
+    /**
+     * @return number of states of the automaton.
+     */
+    int stateCount() const
+    { return (int) _output.size(); }
+
+    /**
+     * @return true if the automaton has its complete DFA, see MAX_DENSE_TRANSITIONS.
+     */
+    bool isDense() const
+    { return !_next.empty(); }
+
+    /**
+     * @param p index of a pattern
+     * @return the pattern.
+     */
+    const std::string &pattern(int p) const
+    { return _patterns.at((size_t) p); }
+
+    /**
+     * @param p index of a pattern
+     * @return weight of the pattern, the sum of the weights of its phrases.
+     */
+    int weight(int p) const
+    { return _weights.at((size_t) p); }
+
+    /**
+     * Reusable state of scans, to scan many texts with one automaton without allocating per text.
+     * The position from which every pattern may occur again is only valid when stamped with the
+     * current text, so starting a new text costs O(1) rather than O(patterns). A text may be fed in
+     * chunks: the state of the automaton carries over, so occurrences spanning chunks are found,
+     * and only the current chunk has to be in memory. Scanners are not thread safe, but any number
+     * of them may share an automaton.
+     */
+    class Scanner
+    {
+        const AhoCorasick *_automaton;
+        std::vector<size_t> _resume; // first start counted for every pattern in the current text
+        std::vector<uint32_t> _stamp; // text for which _resume of every pattern was set
+        uint32_t _text; // stamp of the current text
+        int _state; // state of the automaton after the text fed so far
+        size_t _offset; // length of the text fed so far
+
+    public:
+        /**
+         * Constructor of a scanner of an automaton, which must outlive it.
+         * @param automaton automaton
+         */
+        explicit Scanner(const AhoCorasick &automaton) : _automaton(&automaton),
+                                                         _resume(automaton._patterns.size()),
+                                                         _stamp(automaton._patterns.size(), 0),
+                                                         _text(0), _state(ROOT),
+                                                         _offset(0)
+        {}
+
+        /**
+         * Starts a new text, to be fed in chunks.
+         */
+        void begin()
+        {
+            if (++_text == 0) // stamps wrapped around
+            {
+                std::fill(_stamp.begin(), _stamp.end(), 0);
+                _text = 1;
+            }
+            _state = ROOT;
+            _offset = 0;
+        }
+
+        /**
+         * Feeds the next chunk of the current text, calling found on every occurrence of a pattern
+         * ending in it, in the order of their ends; for one pattern, occurrences overlapping the
+         * previous one are skipped.
+         * @param chunk next chunk of the text, normalized like the phrases (see normalize())
+         * @param found function object called as found(int pattern, size_t start), where start is
+         * a position in the whole text
+         */
+        template<typename F>
+        void feed(std::string_view chunk, F found)
+        {
+            const AhoCorasick &a = *_automaton;
+            int state = _state;
+            for (size_t i = 0; i < chunk.size(); ++i)
+            {
+                state = a._step(state, a._classOf[(unsigned char) chunk[i]]);
+                for (int s = a._output[state] != -1 ? state : a._dictionary[state]; s != -1;
+                     s = a._dictionary[s])
+                {
+                    int p = a._output[s];
+                    size_t end = _offset + i + 1;
+                    size_t start = end - a._patterns[p].size();
+                    if (_stamp[p] != _text || start >= _resume[p])
+                    {
+                        _stamp[p] = _text;
+                        _resume[p] = end;
+                        found(p, start);
+                    }
+                }
+            }
+            _state = state;
+            _offset += chunk.size();
+        }
+
+        /**
+         * Feeds the next chunk of the current text, see feed.
+         * @param chunk next chunk of the text, normalized like the phrases (see normalize())
+         * @return sum of the weights of the occurrences of the patterns ending in chunk.
+         */
+        int feedScore(std::string_view chunk)
+        {
+            int score = 0;
+            const std::vector<int> &weights = _automaton->_weights;
+            feed(chunk, [&weights, &score](int p, size_t)
+            { score += weights[p]; });
+            return score;
+        }
+
+        /**
+         * Scans a whole text, see feed.
+         * @param text text, normalized like the phrases (see normalize())
+         * @param found function object called as found(int pattern, size_t start)
+         */
+        template<typename F>
+        void scan(std::string_view text, F found)
+        {
+            begin();
+            feed(text, found);
+        }
+
+        /**
+         * @param text text, normalized like the phrases (see normalize())
+         * @return sum of the weights of the occurrences of the patterns in text, see feed.
+         */
+        int score(std::string_view text)
+        {
+            begin();
+            return feedScore(text);
+        }
+    };
+
+    /**
+     * Scans a text with a new Scanner, see Scanner::scan.
+     * @param text text, normalized like the phrases (see normalize())
+     * @param found function object called as found(int pattern, size_t start)
+     */
+    template<typename F>
+    void scan(std::string_view text, F found) const
+    {
+        Scanner(*this).scan(text, found);
+    }
+
+    /**
+     * @param text text, normalized like the phrases (see normalize())
+     * @return number of occurrences of every pattern in text, see Scanner::scan.
+     */
+    std::vector<int> count(std::string_view text) const
+    {
+        std::vector<int> counts(_patterns.size(), 0);
+        scan(text, [&counts](int p, size_t)
+        { ++counts[p]; });
+        return counts;
+    }
+
+    /**
+     * @param text text, normalized like the phrases (see normalize())
+     * @return sum of the weights of the occurrences of the patterns in text, see Scanner::scan.
+     */
+    int score(std::string_view text) const
+    {
+        return Scanner(*this).score(text);
+    }
+};
+
+
+#endif //EX3_AHOCORASICK_H
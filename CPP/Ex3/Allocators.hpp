@@ -0,0 +1,344 @@
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+
+#ifndef EX3_ALLOCATORS_H
+#define EX3_ALLOCATORS_H
+
+/**
+ * A monotonic memory resource: it carves allocations out of blocks of doubling size and never
+ * frees them one by one; release() frees all of them in one step. It suits short-lived maps, such
+ * as a per-request scratch HashMap, which are thrown away whole.
+ * It is not thread safe: every thread building temporary maps should own its arena, which then
+ * never contends on the global allocator.
+ */
+class MonotonicArena
+{
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 4096;
+
+    /**
+     * Header of a block, followed by its memory.
+     */
+    struct _Block
+    {
+        _Block *previous;
+        size_t size;
+    };
+
+    _Block *_blocks; // most recent block, chained to the previous ones
+    unsigned char *_current; // free memory of the most recent block
+    size_t _left; // number of free bytes at _current
+    size_t _nextSize; // size of the next block
+
+    /**
+     * Allocates a block large enough for an allocation of the given size and alignment.
+     * @param bytes size of the allocation
+     * @param alignment alignment of the allocation
+     */
+    void _grow(size_t bytes, size_t alignment)
+    {
+        size_t needed = bytes + alignment;
+        while (_nextSize < needed)
+        {
+            _nextSize <<= 1;
+        }
+        auto *block = static_cast<_Block *>(::operator new(sizeof(_Block) + _nextSize));
+        block->previous = _blocks;
+        block->size = _nextSize;
+        _blocks = block;
+        _current = reinterpret_cast<unsigned char *>(block + 1);
+        _left = _nextSize;
+        _nextSize <<= 1;
+    }
+
+public:
+    /**
+     * Constructor of an empty arena.
+     * @param initialBlockSize size of the first block, doubled for every following one
+     */
+    explicit MonotonicArena(size_t initialBlockSize = DEFAULT_BLOCK_SIZE)
+            : _blocks(nullptr), _current(nullptr), _left(0),
+              _nextSize(initialBlockSize == 0 ? 1 : initialBlockSize)
+    {}
+
+    /**
+     * Allocations are owned by the arena, which can not be copied.
+     */
+    MonotonicArena(const MonotonicArena &other) = delete;
+
+    /**
+     * Allocations are owned by the arena, which can not be copied.
+     */
+    MonotonicArena &operator=(const MonotonicArena &other) = delete;
+
+    /**
+     * Destructor, frees every allocation.
+     */
+    ~MonotonicArena()
+    {
+        release();
+    }
+
+    /**
+     * @param bytes size of the allocation
+     * @param alignment alignment of the allocation, a power of 2
+     * @return pointer to bytes of uninitialized memory; throws std::bad_alloc on failure.
+     */
+    void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        size_t padding = (alignment - (reinterpret_cast<uintptr_t>(_current) & (alignment - 1))) &
+                         (alignment - 1);
+        if (_current == nullptr || _left < padding + bytes)
+        {
+            _grow(bytes, alignment);
+            padding = (alignment - (reinterpret_cast<uintptr_t>(_current) & (alignment - 1))) &
+                      (alignment - 1);
+        }
+        void *p = _current + padding;
+        _current += padding + bytes;
+        _left -= padding + bytes;
+        return p;
+    }
+
+    /**
+     * Does nothing: memory is only given back by release().
+     */
+    void deallocate(void *, size_t, size_t = alignof(std::max_align_t)) noexcept
+    {}
+
+    /**
+     * Frees every allocation at once; the arena may be used again afterwards.
+     */
+    void release() noexcept
+    {
+        while (_blocks != nullptr)
+        {
+            _Block *previous = _blocks->previous;
+            ::operator delete(_blocks);
+            _blocks = previous;
+        }
+        _current = nullptr;
+        _left = 0;
+    }
+};
+
+/**
+ * A pool memory resource: allocations are rounded up to a power of 2 size class, between 16 and
+ * 4096 bytes, and freed memory is kept in a free list per size class, to be reused by the next
+ * allocation of the class. The memory of the classes comes from a MonotonicArena, so release()
+ * frees everything in one step. Larger or over-aligned allocations go to the global allocator.
+ * It suits maps which grow and shrink, whose tables and entry segments come back in the same sizes.
+ * It is not thread safe: every thread should own its pool.
+ */
+class PoolResource
+{
+    static constexpr int MIN_CLASS_BITS = 4;
+    static constexpr int CLASS_COUNT = 9; // 16 .. 4096 bytes
+    static constexpr size_t MAX_POOLED = (size_t) 1 << (MIN_CLASS_BITS + CLASS_COUNT - 1);
+
+    /**
+     * A freed chunk, linked to the next free chunk of its size class.
+     */
+    struct _FreeChunk
+    {
+        _FreeChunk *next;
+    };
+
+    MonotonicArena _arena;
+    _FreeChunk *_free[CLASS_COUNT];
+
+    /**
+     * @param bytes size of an allocation, at most MAX_POOLED
+     * @return size class of the allocation.
+     */
+    static int _classOf(size_t bytes)
+    {
+        int c = 0;
+        while (((size_t) 1 << (MIN_CLASS_BITS + c)) < bytes)
+        {
+            ++c;
+        }
+        return c;
+    }
+
+    /**
+     * @param bytes size of an allocation
+     * @param alignment alignment of the allocation
+     * @return true if the allocation is served from the size classes; false otherwise.
+     */
+    static bool _pooled(size_t bytes, size_t alignment)
+    {
+        return bytes <= MAX_POOLED && alignment <= alignof(std::max_align_t);
+    }
+
+public:
+    /**
+     * Constructor of an empty pool.
+     */
+    PoolResource() : _free()
+    {}
+
+    /**
+     * Allocations are owned by the pool, which can not be copied.
+     */
+    PoolResource(const PoolResource &other) = delete;
+
+    /**
+     * Allocations are owned by the pool, which can not be copied.
+     */
+    PoolResource &operator=(const PoolResource &other) = delete;
+
+    /**
+     * @param bytes size of the allocation
+     * @param alignment alignment of the allocation, a power of 2
+     * @return pointer to bytes of uninitialized memory; throws std::bad_alloc on failure.
+     */
+    void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        if (!_pooled(bytes, alignment))
+        {
+            // plain operator new only guarantees __STDCPP_DEFAULT_NEW_ALIGNMENT__
+            return alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__
+                   ? ::operator new(bytes, std::align_val_t(alignment)) : ::operator new(bytes);
+        }
+        int c = _classOf(bytes);
+        if (_free[c] != nullptr)
+        {
+            _FreeChunk *chunk = _free[c];
+            _free[c] = chunk->next;
+            return chunk;
+        }
+        return _arena.allocate((size_t) 1 << (MIN_CLASS_BITS + c));
+    }
+
+    /**
+     * Gives an allocation back to its size class.
+     * @param p pointer returned by allocate
+     * @param bytes size of the allocation
+     * @param alignment alignment of the allocation
+     */
+    void deallocate(void *p, size_t bytes, size_t alignment = alignof(std::max_align_t)) noexcept
+    {
+        if (!_pooled(bytes, alignment))
+        {
+            if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+            {
+                ::operator delete(p, bytes, std::align_val_t(alignment));
+            }
+            else
+            {
+                ::operator delete(p, bytes);
+            }
+            return;
+        }
+        int c = _classOf(bytes);
+        auto *chunk = static_cast<_FreeChunk *>(p);
+        chunk->next = _free[c];
+        _free[c] = chunk;
+    }
+
+    /**
+     * Frees every pooled allocation at once; allocations larger than the size classes must have
+     * been deallocated before.
+     */
+    void release() noexcept
+    {
+        for (auto &list : _free)
+        {
+            list = nullptr;
+        }
+        _arena.release();
+    }
+};
+
+/**
+ * A standard allocator which forwards to a memory resource (MonotonicArena or PoolResource) that it
+ * does not own. Copies, and rebinds to other types, share the resource, so a HashMap's entries and
+ * index tables, and its keys if they use the allocator too, come from the same resource.
+ * The resource must outlive every container using it.
+ * @tparam T type of allocated objects
+ * @tparam Resource memory resource
+ */
+template<typename T, typename Resource>
+class ResourceAllocator
+{
+    template<typename U, typename R>
+    friend class ResourceAllocator;
+
+    Resource *_resource;
+
+public:
+    typedef T value_type;
+
+    /**
+     * Constructor of an allocator of the given resource.
+     * @param resource memory resource
+     */
+    ResourceAllocator(Resource &resource) noexcept : _resource(&resource)
+    {}
+
+    /**
+     * Rebinding constructor, sharing the resource of other.
+     * @param other allocator of another type
+     */
+    template<typename U>
+    ResourceAllocator(const ResourceAllocator<U, Resource> &other) noexcept
+            : _resource(other._resource)
+    {}
+
+    /**
+     * @param n number of objects
+     * @return uninitialized memory for n objects of type T.
+     */
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(_resource->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    /**
+     * @param p memory returned by allocate
+     * @param n number of objects passed to allocate
+     */
+    void deallocate(T *p, size_t n) noexcept
+    {
+        _resource->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    /**
+     * @return the memory resource.
+     */
+    Resource &resource() const
+    { return *_resource; }
+
+    /**
+     * @return true if both allocators share a resource, so one frees what the other allocated.
+     */
+    template<typename U>
+    bool operator==(const ResourceAllocator<U, Resource> &other) const
+    { return _resource == other._resource; }
+
+    /**
+     * @return true if the allocators have different resources; false otherwise.
+     */
+    template<typename U>
+    bool operator!=(const ResourceAllocator<U, Resource> &other) const
+    { return _resource != other._resource; }
+};
+
+/**
+ * An allocator from a MonotonicArena.
+ */
+template<typename T>
+using ArenaAllocator = ResourceAllocator<T, MonotonicArena>;
+
+/**
+ * An allocator from a PoolResource.
+ */
+template<typename T>
+using PoolAllocator = ResourceAllocator<T, PoolResource>;
+
+
+#endif //EX3_ALLOCATORS_H
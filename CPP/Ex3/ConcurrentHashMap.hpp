@@ -0,0 +1,284 @@
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <utility>
+#include "HashMap.hpp"
+
+
+#ifndef EX3_CONCURRENTHASHMAP_H
+#define EX3_CONCURRENTHASHMAP_H
+
+/**
+ * A thread safe hashmap, sharding the key space into independently locked HashMaps.
+ * The shard of a key is chosen by bits of its hash that its shard's table does not use for the
+ * home slot, so every shard sees well spread keys. A key is hashed once, and its hash is reused
+ * for the lookup in the shard.
+ * Readers take their shard's lock in shared mode, so they only contend with writers to the same
+ * shard; every shard sits on its own cache line, so readers of different shards do not share one.
+ * Values are returned by copy, since a reference could not outlive the lock of its shard.
+ * @tparam KeyT key of type KeyT
+ * @tparam ValueT value of type ValueT
+ * @tparam Hash hash function object of keys; HashMapHash by default
+ * @tparam KeyEqual equality predicate of keys; operator== by default
+ */
+template<typename KeyT, typename ValueT, typename Hash = HashMapHash<KeyT>,
+        typename KeyEqual = std::equal_to<>>
+class ConcurrentHashMap
+{
+    using map = HashMap<KeyT, ValueT, Hash, KeyEqual>;
+
+    static constexpr int CACHE_LINE = 64;
+    static constexpr int DEFAULT_SHARD_COUNT = 64;
+    static constexpr int SHARD_SHIFT = std::numeric_limits<size_t>::digits / 2;
+
+    /**
+     * A sub-map and the lock guarding it.
+     */
+    struct alignas(CACHE_LINE) _Shard
+    {
+        mutable std::shared_mutex mutex;
+        map table;
+    };
+
+    std::unique_ptr<_Shard[]> _shards;
+    int _shardCount; // a power of 2
+    Hash _hashFunction;
+
+// ================================ PRIVATE HELPER METHODS =======================================
+
+    /**
+     * @param hash full hash of a key
+     * @return shard of the key.
+     */
+    _Shard &_shardOf(size_t hash) const
+    {
+        return _shards[(hash >> SHARD_SHIFT) & (size_t) (_shardCount - 1)];
+    }
+
+    /**
+     * Inserts a key if it does not exist, or updates its value otherwise, under the exclusive lock
+     * of its shard.
+     * @param key key to insert or update
+     * @param value value to insert if key does not exist
+     * @param update function object called on the value of key if key exists
+     * @return true if key was inserted; false if it was updated.
+     */
+    template<typename V, typename F>
+    bool _upsert(const KeyT &key, V &&value, F &update)
+    {
+        size_t hash = _hashFunction(key);
+        _Shard &shard = _shardOf(hash);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        bool found;
+        int idx = shard.table._findOrPrepareInsert(key, hash, found);
+        if (found)
+        {
+            update(shard.table._entryAt(idx).kv.second);
+            return false;
+        }
+        shard.table._constructAt(idx, hash, key, std::forward<V>(value));
+        return true;
+    }
+
+public:
+
+// ================================= CTORS, DTOR & RULE OF 5 =====================================
+
+    /**
+     * Constructor of a concurrent hashmap.
+     * @param shardCount number of independently locked sub-maps, rounded up to a power of 2;
+     * it bounds the number of writers working at the same time
+     * @param policy resize policy of every sub-map; its maxProbeLength is ignored, since a sub-map
+     * must keep the hash function of the concurrent hashmap, which chooses its shard
+     * @param hash hash function object
+     * @param equal equality predicate
+     */
+    explicit ConcurrentHashMap(int shardCount = DEFAULT_SHARD_COUNT,
+                               const HashMapResizePolicy &policy = HashMapResizePolicy(),
+                               const Hash &hash = Hash(), const KeyEqual &equal = KeyEqual())
+            : _shardCount(1), _hashFunction(hash)
+    {
+        if (shardCount < 1 || shardCount > (std::numeric_limits<int>::max() >> 1) + 1)
+        {
+            throw std::invalid_argument("Invalid shard count");
+        }
+        while (_shardCount < shardCount)
+        {
+            _shardCount <<= 1;
+        }
+        _shards.reset(new _Shard[_shardCount]);
+        HashMapResizePolicy shardPolicy = policy;
+        shardPolicy.maxProbeLength = 0;
+        for (int i = 0; i < _shardCount; ++i)
+        {
+            _shards[i].table = map(shardPolicy, hash, equal);
+        }
+    }
+
+    /**
+     * The locks of a concurrent hashmap can not be copied nor moved.
+     */
+    ConcurrentHashMap(const ConcurrentHashMap &other) = delete;
+
+    /**
+     * The locks of a concurrent hashmap can not be copied nor moved.
+     */
+    ConcurrentHashMap &operator=(const ConcurrentHashMap &other) = delete;
+
+// ====================================== PUBLIC METHODS =========================================
+
+    /**
+     * @return number of shards.
+     */
+    int shardCount() const
+    { return _shardCount; }
+
+    /**
+     * Counts the elements shard by shard; with concurrent writers, the result is only a snapshot.
+     * @return number of elements in hashmap.
+     */
+    int size() const
+    {
+        int size = 0;
+        for (int i = 0; i < _shardCount; ++i)
+        {
+            std::shared_lock<std::shared_mutex> lock(_shards[i].mutex);
+            size += _shards[i].table.size();
+        }
+        return size;
+    }
+
+    /**
+     * @return true if hashmap is empty; false otherwise.
+     */
+    bool empty() const
+    { return size() == 0; }
+
+#ifdef HASHMAP_ENABLE_STATS
+
+    /**
+     * Sums the statistics of the shards (see HashMap::stats), each under the shared lock of its
+     * shard; only available if HASHMAP_ENABLE_STATS is defined.
+     * @return statistics of the hashmap.
+     */
+    HashMapStats stats() const
+    {
+        HashMapStats stats;
+        for (int i = 0; i < _shardCount; ++i)
+        {
+            std::shared_lock<std::shared_mutex> lock(_shards[i].mutex);
+            stats += _shards[i].table.stats();
+        }
+        return stats;
+    }
+
+#endif
+
+    /**
+     * Looks a key up and copies its value.
+     * @param key key to look for
+     * @param value output - value of key, if key exists; unchanged otherwise.
+     * @return true if key exists in hashmap; false otherwise.
+     */
+    bool find(const KeyT &key, ValueT &value) const
+    {
+        size_t hash = _hashFunction(key);
+        const _Shard &shard = _shardOf(hash);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        int e = shard.table._findEntry(key, hash);
+        if (e == -1)
+        {
+            return false;
+        }
+        value = shard.table._entryAt(e).kv.second;
+        return true;
+    }
+
+    /**
+     * @param key key to look for
+     * @return true if key exists in hashmap; false otherwise.
+     */
+    bool containsKey(const KeyT &key) const
+    {
+        size_t hash = _hashFunction(key);
+        const _Shard &shard = _shardOf(hash);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.table._findEntry(key, hash) != -1;
+    }
+
+    /**
+     * Inserts a key and its value, unless key already exists.
+     * @param key key to insert
+     * @param value value to insert
+     * @return true if insertion was successful; false otherwise.
+     */
+    bool insert(const KeyT &key, const ValueT &value)
+    {
+        auto keep = [](ValueT &)
+        {};
+        return _upsert(key, value, keep);
+    }
+
+    /**
+     * Inserts a key and its value if key does not exist; otherwise calls update on its value.
+     * update runs under the exclusive lock of the key's shard: it must not access this hashmap.
+     * @param key key to insert or update
+     * @param update function object called as update(ValueT &) if key exists
+     * @param value value to insert if key does not exist
+     * @return true if key was inserted; false if it was updated.
+     */
+    template<typename F>
+    bool upsert(const KeyT &key, F update, const ValueT &value)
+    {
+        return _upsert(key, value, update);
+    }
+
+    /**
+     * Removes a key from hashmap if key exists.
+     * @param key key to remove
+     * @return true if key was erased; false otherwise.
+     */
+    bool erase(const KeyT &key)
+    {
+        size_t hash = _hashFunction(key);
+        _Shard &shard = _shardOf(hash);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.table._erase(key, hash);
+    }
+
+    /**
+     * Removes all elements, shard by shard.
+     */
+    void clear()
+    {
+        for (int i = 0; i < _shardCount; ++i)
+        {
+            std::unique_lock<std::shared_mutex> lock(_shards[i].mutex);
+            _shards[i].table.clear();
+        }
+    }
+
+    /**
+     * Calls visit on every pair, shard by shard, each under the shared lock of its shard; pairs
+     * inserted or erased meanwhile in other shards may or may not be visited.
+     * visit must not access this hashmap.
+     * @param visit function object called as visit(const KeyT &, const ValueT &)
+     */
+    template<typename F>
+    void forEach(F visit) const
+    {
+        for (int i = 0; i < _shardCount; ++i)
+        {
+            std::shared_lock<std::shared_mutex> lock(_shards[i].mutex);
+            for (const auto &p : _shards[i].table)
+            {
+                visit(p.first, p.second);
+            }
+        }
+    }
+};
+
+
+#endif //EX3_CONCURRENTHASHMAP_H
@@ -0,0 +1,332 @@
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "HashMap.hpp"
+
+
+#ifndef EX3_FROZENHASHMAP_H
+#define EX3_FROZENHASHMAP_H
+
+/**
+ * An immutable hashmap, built once from a HashMap (see HashMap::freeze) and optimized for lookups.
+ * Its pairs are sorted by bucket into one array, and the pairs of bucket b are those between
+ * offsets[b] and offsets[b + 1] (compressed rows): there are no empty slots or tombstones, and the
+ * full hash of every pair is kept in a parallel array, so a lookup compares keys only on a full
+ * hash match. As nothing in it ever changes, any number of threads may read it at the same time.
+ * @tparam KeyT key of type KeyT
+ * @tparam ValueT value of type ValueT
+ * @tparam Hash hash function object of keys; HashMapHash by default
+ * @tparam KeyEqual equality predicate of keys; operator== by default
+ */
+template<typename KeyT, typename ValueT, typename Hash = HashMapHash<KeyT>,
+        typename KeyEqual = std::equal_to<>>
+class FrozenHashMap
+{
+    using pair = std::pair<KeyT, ValueT>;
+
+    std::vector<pair> _entries; // pairs, sorted by bucket
+    std::vector<size_t> _hashes; // full hash of every pair of _entries
+    std::vector<int> _offsets; // first index of every bucket in _entries, and the size at the end
+    size_t _mask; // number of buckets - 1, a power of 2 - 1
+    Hash _hashFunction;
+    KeyEqual _keyEqual;
+
+// ================================ PRIVATE HELPER METHODS =======================================
+
+    /**
+     * @param key key to look for
+     * @return index of the pair of key in _entries if key exists; -1 otherwise.
+     */
+    int _findIndex(const KeyT &key) const
+    {
+        size_t hash = _hashFunction(key);
+        size_t bucket = hash & _mask;
+        for (int i = _offsets[bucket], last = _offsets[bucket + 1]; i < last; ++i)
+        {
+            if (_hashes[i] == hash && _keyEqual(_entries[i].first, key))
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+public:
+    typedef typename std::vector<pair>::const_iterator const_iterator;
+
+// ================================= CTORS, DTOR & RULE OF 5 =====================================
+
+    /**
+     * Constructor of an empty frozen hashmap.
+     */
+    FrozenHashMap() : FrozenHashMap(HashMap<KeyT, ValueT, Hash, KeyEqual>())
+    {}
+
+    /**
+     * Constructor which freezes the pairs of a hashmap; there are as many buckets as the smallest
+     * power of 2 which is at least the number of pairs.
+     * @tparam Allocator allocator of the hashmap
+     * @param map hashmap to freeze
+     */
+    template<typename Allocator>
+    explicit FrozenHashMap(const HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator> &map)
+            : _mask(0), _hashFunction(map.hash_function()), _keyEqual(map.key_eq())
+    {
+        size_t buckets = 1;
+        while (buckets < (size_t) map.size())
+        {
+            buckets <<= 1;
+        }
+        _mask = buckets - 1;
+        std::vector<size_t> hashes;
+        hashes.reserve(map.size());
+        _offsets.assign(buckets + 1, 0);
+        for (const auto &p : map)
+        {
+            hashes.push_back(_hashFunction(p.first));
+            ++_offsets[(hashes.back() & _mask) + 1];
+        }
+        for (size_t b = 0; b < buckets; ++b)
+        {
+            _offsets[b + 1] += _offsets[b];
+        }
+        std::vector<int> order(map.size()); // index in _entries of the i-th pair of map
+        std::vector<int> next(_offsets.begin(), _offsets.end() - 1);
+        for (size_t i = 0; i < hashes.size(); ++i)
+        {
+            order[i] = next[hashes[i] & _mask]++;
+        }
+        std::vector<const pair *> sources(map.size());
+        int i = 0;
+        for (const auto &p : map)
+        {
+            sources[order[i++]] = &p;
+        }
+        _entries.reserve(map.size());
+        _hashes.resize(map.size());
+        for (size_t j = 0; j < sources.size(); ++j)
+        {
+            _entries.push_back(*sources[j]);
+        }
+        for (size_t j = 0; j < hashes.size(); ++j)
+        {
+            _hashes[order[j]] = hashes[j];
+        }
+    }
+
+// ======================================= API METHODS ===========================================
+
+    /**
+     * @return number of pairs.
+     */
+    int size() const
+    { return (int) _entries.size(); }
+
+    /**
+     * @return true if the frozen hashmap is empty; false otherwise.
+     */
+    bool empty() const
+    { return _entries.empty(); }
+
+    /**
+     * @return number of buckets.
+     */
+    int bucketCount() const
+    { return (int) _mask + 1; }
+
+    /**
+     * @param key key to look for
+     * @return pointer to the value of key if key exists; nullptr otherwise.
+     */
+    const ValueT *find(const KeyT &key) const
+    {
+        int i = _findIndex(key);
+        return i == -1 ? nullptr : &_entries[i].second;
+    }
+
+    /**
+     * @param key key to look for
+     * @return true if key exists; false otherwise.
+     */
+    bool containsKey(const KeyT &key) const
+    { return _findIndex(key) != -1; }
+
+    /**
+     * @param key key to look for
+     * @return value of key if key exists; throws std::out_of_range otherwise.
+     */
+    const ValueT &at(const KeyT &key) const
+    {
+        int i = _findIndex(key);
+        if (i == -1)
+        {
+            throw std::out_of_range("Invalid key");
+        }
+        return _entries[i].second;
+    }
+
+    /**
+     * @return iterator to the first pair, in bucket order.
+     */
+    const_iterator begin() const
+    { return _entries.begin(); }
+
+    /**
+     * @return iterator past the last pair.
+     */
+    const_iterator end() const
+    { return _entries.end(); }
+};
+
+/**
+ * Publishes immutable snapshots (e.g. a FrozenHashMap) to readers which never take a lock:
+ * a writer builds a new snapshot and swaps it in; readers which hold the old one keep reading it,
+ * and it is only destroyed once no reader can reach it anymore.
+ * Readers announce themselves on one of two counters, selected by the current epoch, before
+ * loading the snapshot pointer. After swapping the pointer, a writer flips the epoch and waits for
+ * the readers of the previous epoch to leave, twice: a reader which read the epoch just before the
+ * first flip may only announce itself after the writer checked its counter, but it then loads the
+ * new pointer, and is waited for by the second flip (of this writer, or of the next one).
+ * Writers are serialized by a mutex, and wait for readers by yielding.
+ * @tparam T type of snapshots
+ */
+template<typename T>
+class SnapshotCell
+{
+    static constexpr int CACHE_LINE = 64;
+
+    /**
+     * A reader counter, on its own cache line.
+     */
+    struct alignas(CACHE_LINE) _Counter
+    {
+        std::atomic<long> readers{0};
+    };
+
+    std::atomic<const T *> _current;
+    std::atomic<int> _epoch;
+    mutable _Counter _counters[2];
+    std::mutex _writer;
+
+    /**
+     * Waits until no reader can hold a snapshot which was replaced before the call.
+     */
+    void _synchronize()
+    {
+        for (int flip = 0; flip < 2; ++flip)
+        {
+            int epoch = _epoch.fetch_xor(1);
+            while (_counters[epoch & 1].readers.load() != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+public:
+    /**
+     * A pinned snapshot: the snapshot it points to is not destroyed before it is released.
+     * Readers should keep one for a batch of lookups, rather than pin the snapshot for each.
+     */
+    class ReadGuard
+    {
+        friend class SnapshotCell;
+
+        const T *_snapshot;
+        std::atomic<long> *_readers;
+
+        /**
+         * Constructor of a guard holding a counted reader.
+         */
+        ReadGuard(const T *snapshot, std::atomic<long> *readers) : _snapshot(snapshot),
+                                                                   _readers(readers)
+        {}
+
+    public:
+        /**
+         * Move constructor; other releases nothing.
+         */
+        ReadGuard(ReadGuard &&other) noexcept : _snapshot(other._snapshot),
+                                                _readers(other._readers)
+        {
+            other._readers = nullptr;
+        }
+
+        ReadGuard(const ReadGuard &other) = delete;
+
+        ReadGuard &operator=(const ReadGuard &other) = delete;
+
+        /**
+         * Destructor, releases the snapshot.
+         */
+        ~ReadGuard()
+        {
+            if (_readers != nullptr)
+            {
+                _readers->fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        /**
+         * @return the pinned snapshot.
+         */
+        const T &operator*() const
+        { return *_snapshot; }
+
+        /**
+         * @return the pinned snapshot.
+         */
+        const T *operator->() const
+        { return _snapshot; }
+    };
+
+    /**
+     * Constructor which publishes an initial snapshot.
+     * @param snapshot initial snapshot
+     */
+    explicit SnapshotCell(T snapshot = T()) : _current(new T(std::move(snapshot))), _epoch(0)
+    {}
+
+    SnapshotCell(const SnapshotCell &other) = delete;
+
+    SnapshotCell &operator=(const SnapshotCell &other) = delete;
+
+    /**
+     * Destructor; no reader may be left.
+     */
+    ~SnapshotCell()
+    {
+        delete _current.load();
+    }
+
+    /**
+     * Pins the current snapshot, without locking.
+     * @return guard of the current snapshot.
+     */
+    ReadGuard read() const
+    {
+        std::atomic<long> *readers = &_counters[_epoch.load() & 1].readers;
+        readers->fetch_add(1);
+        return ReadGuard(_current.load(), readers);
+    }
+
+    /**
+     * Replaces the current snapshot, and destroys the previous one once its readers are gone.
+     * @param snapshot new snapshot
+     */
+    void publish(T snapshot)
+    {
+        const T *next = new T(std::move(snapshot));
+        std::lock_guard<std::mutex> lock(_writer);
+        const T *previous = _current.exchange(next);
+        _synchronize();
+        delete previous;
+    }
+};
+
+
+#endif //EX3_FROZENHASHMAP_H
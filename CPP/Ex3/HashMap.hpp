@@ -4,424 +4,2468 @@
 
 #include <vector>
 #include <utility>
+#include <cstdint>
 #include <algorithm>
 #include <exception>
 #include <iostream>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include "HashMapHash.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#ifdef HASHMAP_ENABLE_STATS
+#include <atomic>
+#include <chrono>
+#endif
 
 
 #ifndef EX3_HASHMAP_H
 #define EX3_HASHMAP_H
 
+/**
+ * Controls when a HashMap resizes its table. The defaults double the table when an insertion would
+ * exceed a load factor of 0.75, and halve it as soon as an erase leaves it under 0.25.
+ * A table whose load factor hovers around a bound resizes back and forth, so churn-heavy maps can
+ * make shrinking lazier, or stop it below some capacity.
+ */
+struct HashMapResizePolicy
+{
+    double lowerLoadFactor = 0.25; // the table is halved when its load factor drops below it
+    double upperLoadFactor = 0.75; // the table is doubled when an insertion would exceed it
+    double shrinkHysteresis = 0; // a table is halved only if its load factor afterwards is at most
+    // upperLoadFactor * (1 - shrinkHysteresis), i.e. stays clear of the next doubling
+    int minCapacity = 1; // the table is never halved below this capacity
+    int shrinkDelay = 0; // number of consecutive erases which may leave the table under the lower
+    // load factor before it is halved; an insertion in between resets the count
+    int maxProbeLength = 512; // an insertion probing more slots than this, which a good hash
+    // function practically never does, is taken for hash flooding: a hashmap whose Hash has
+    // reseed() (see SeededHash) then reseeds it and rehashes every key; 0 never reseeds
+
+    /**
+     * @param other other policy
+     * @return true if both policies are identical; false otherwise.
+     */
+    bool operator==(const HashMapResizePolicy &other) const
+    {
+        return lowerLoadFactor == other.lowerLoadFactor &&
+               upperLoadFactor == other.upperLoadFactor &&
+               shrinkHysteresis == other.shrinkHysteresis && minCapacity == other.minCapacity &&
+               shrinkDelay == other.shrinkDelay && maxProbeLength == other.maxProbeLength;
+    }
+};
+
+#ifdef HASHMAP_ENABLE_STATS
+
+/**
+ * Statistics of a HashMap, returned by HashMap::stats(). They are only collected if
+ * HASHMAP_ENABLE_STATS is defined before HashMap.hpp is included, in every translation unit or in
+ * none; otherwise HashMap keeps no counters and has no stats().
+ * The probe lengths describe the table as it is: the probe length of a key is the number of
+ * control groups a lookup of it compares, so a histogram leaning to long probes reveals a weak
+ * hash function, a too high upper load factor, or keys chosen to collide (hash flooding). The
+ * counters accumulate from the creation of the hashmap, or from its last resetStats().
+ */
+struct HashMapStats
+{
+    static constexpr int HISTOGRAM_SIZE = 16;
+
+    uint64_t probeLengths[HISTOGRAM_SIZE] = {}; // probeLengths[i]: number of keys whose probe
+    // length is i + 1 groups; the last one also counts the longer probes
+    int maxProbeLength = 0; // longest probe length of a key, in groups
+    int groupWidth = 0; // number of slots of a group
+    uint64_t hits = 0; // lookups which found their key
+    uint64_t misses = 0; // lookups which did not find their key
+    uint64_t hitProbeGroups = 0; // groups probed by the lookups which found their key
+    uint64_t missProbeGroups = 0; // groups probed by the lookups which did not find their key
+    int maxHitProbeLength = 0; // most groups probed by a lookup which found its key
+    int maxMissProbeLength = 0; // most groups probed by a lookup which did not find its key
+    uint64_t resizes = 0; // tables allocated in a new capacity
+    uint64_t rebuilds = 0; // tables rebuilt in the same capacity, to drop tombstones
+    uint64_t reseeds = 0; // hash function reseeds after over-long probes, see maxProbeLength
+    uint64_t rehashNanoseconds = 0; // time spent in resizes, rebuilds and incremental migration
+
+    /**
+     * Adds the statistics of another hashmap, e.g. of another shard.
+     * @param other statistics of another hashmap
+     * @return these statistics
+     */
+    HashMapStats &operator+=(const HashMapStats &other)
+    {
+        for (int i = 0; i < HISTOGRAM_SIZE; ++i)
+        {
+            probeLengths[i] += other.probeLengths[i];
+        }
+        maxProbeLength = std::max(maxProbeLength, other.maxProbeLength);
+        groupWidth = std::max(groupWidth, other.groupWidth);
+        hits += other.hits;
+        misses += other.misses;
+        hitProbeGroups += other.hitProbeGroups;
+        missProbeGroups += other.missProbeGroups;
+        maxHitProbeLength = std::max(maxHitProbeLength, other.maxHitProbeLength);
+        maxMissProbeLength = std::max(maxMissProbeLength, other.maxMissProbeLength);
+        resizes += other.resizes;
+        rebuilds += other.rebuilds;
+        reseeds += other.reseeds;
+        rehashNanoseconds += other.rehashNanoseconds;
+        return *this;
+    }
+
+    /**
+     * @return mean probe length of the keys, in groups, counting the probes longer than the
+     * histogram as HISTOGRAM_SIZE; 0 if there are no keys.
+     */
+    double meanProbeLength() const
+    {
+        uint64_t keys = 0;
+        uint64_t total = 0;
+        for (int i = 0; i < HISTOGRAM_SIZE; ++i)
+        {
+            keys += probeLengths[i];
+            total += probeLengths[i] * (uint64_t) (i + 1);
+        }
+        return keys == 0 ? 0 : (double) total / (double) keys;
+    }
+
+    /**
+     * @return mean number of groups probed by the lookups which found their key; 0 if none did.
+     */
+    double meanHitProbeLength() const
+    { return hits == 0 ? 0 : (double) hitProbeGroups / (double) hits; }
+
+    /**
+     * @return mean number of groups probed by the lookups which did not find their key; 0 if none
+     * did.
+     */
+    double meanMissProbeLength() const
+    { return misses == 0 ? 0 : (double) missProbeGroups / (double) misses; }
+};
+
+#endif
+
+template<typename KeyT, typename ValueT, typename Hash, typename KeyEqual>
+class ConcurrentHashMap;
+
+template<typename KeyT, typename ValueT, typename Hash, typename KeyEqual>
+class FrozenHashMap;
+
+template<typename KeyT, typename ValueT>
+class MappedHashMap;
+
 /**
  * @tparam KeyT keys
  * @tparam ValueT values
+ * @tparam Hash hash function of keys
+ * @tparam KeyEqual equality predicate of keys
+ * @tparam Allocator allocator of the hashmap's memory
  */
-template<typename KeyT, typename ValueT>
+template<typename KeyT, typename ValueT, typename Hash = HashMapHash<KeyT>,
+        typename KeyEqual = std::equal_to<>,
+        typename Allocator = std::allocator<std::pair<KeyT, ValueT>>>
 /**
- * A class implementing the generic hashmap, using a dynamic array of vectors containing pairs of
- * keys and values.
+ * A class implementing the generic hashmap using open addressing. The pairs of keys and values are
+ * kept dense, in insertion order, in an array of entries (each also caching the full hash of its
+ * key); the table itself is an index: for every slot, one byte control tag and the index of the
+ * entry it refers to. A control byte is either EMPTY, DELETED (a tombstone left by erase), or for a
+ * full slot the 7 high bits of the key's hash, so a probe rejects almost every foreign slot by
+ * comparing a single byte, without touching the key itself. Collisions are resolved by linear
+ * probing, a group of control bytes at a time (see _Group). Iterating walks the entries only,
+ * and resizing rebuilds the index from the cached hashes without moving a pair.
+ * A small hashmap allocates nothing: its first few entries are stored inside the object and
+ * searched linearly, and the index table and the entry segments are only allocated once it
+ * outgrows them. Its capacity is still tracked by the resize policy, as if the table existed.
  * @tparam KeyT key of type KeyT
  * @tparam ValueT value of type ValueT
+ * @tparam Hash hash function object of keys; HashMapHash by default
+ * @tparam KeyEqual equality predicate of keys; operator== by default
+ * @tparam Allocator allocator of the entries and the index tables, rebound to each; std::allocator
+ * by default, see Allocators.hpp for an arena and a pool
  */
 class HashMap
 {
     using pair = std::pair<KeyT, ValueT>;
-    using bucket = std::vector<pair>;
-    using bucketIter = typename bucket::iterator;
+    using ctrl_t = signed char;
+
+    friend class ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual>; // hashes keys only once
+
+    /**
+     * True if H declares is_transparent.
+     */
+    template<typename H, typename = void>
+    struct _isTransparent : std::false_type
+    {
+    };
+
+    template<typename H>
+    struct _isTransparent<H, std::void_t<typename H::is_transparent>> : std::true_type
+    {
+    };
+
+    /**
+     * True if H has a reseed() method drawing a new seed, like SeededHash.
+     */
+    template<typename H, typename = void>
+    struct _isReseedable : std::false_type
+    {
+    };
+
+    template<typename H>
+    struct _isReseedable<H, std::void_t<decltype(std::declval<H &>().reseed())>> : std::true_type
+    {
+    };
+
+    /**
+     * Enables the heterogeneous overloads of the lookup methods: when both Hash and KeyEqual are
+     * transparent, K is a type other than KeyT which can be hashed and compared with keys directly,
+     * e.g. std::string_view or const char * for std::string keys.
+     */
+    template<typename K>
+    using _enableIfTransparent = typename std::enable_if<
+            _isTransparent<Hash>::value && _isTransparent<KeyEqual>::value &&
+            !std::is_same<typename std::decay<K>::type, KeyT>::value, int>::type;
+
+public:
+    template<bool IsConst>
+    class basicIterator;
+
+    /**
+     * Iterator over mutable pairs; the key of a pair must not be modified through it.
+     */
+    typedef basicIterator<false> iterator;
+
+    /**
+     * Iterator over const pairs.
+     */
+    typedef basicIterator<true> const_iterator;
 
 private:
+    /**
+     * A pair of the hashmap, with the full hash of its key, so that the key is never hashed again.
+     */
+    struct entry
+    {
+        pair kv;
+        size_t hash;
+
+        /**
+         * Constructs the pair of the entry from args.
+         * @param keyHash full hash of the key
+         * @param args arguments forwarded to the constructor of the pair
+         */
+        template<typename... Args>
+        explicit entry(size_t keyHash, Args &&... args) : kv(std::forward<Args>(args)...),
+                                                          hash(keyHash)
+        {}
+    };
+
+    using entryAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<entry>;
+    using indexAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<int>;
+
+    static constexpr ctrl_t EMPTY = -128;
+    static constexpr ctrl_t DELETED = -2;
+    static constexpr int INITIAL_CAPACITY = 16;
+    static constexpr int FIRST_SEGMENT_BITS = 4; // the first 2 segments hold 16 entries each
+    static constexpr int MAX_SEGMENTS = std::numeric_limits<int>::digits - FIRST_SEGMENT_BITS + 1;
+#if defined(__AVX2__)
+    static constexpr int GROUP_WIDTH = 32; // control bytes compared at once
+#elif defined(__SSE2__)
+    static constexpr int GROUP_WIDTH = 16;
+#else
+    static constexpr int GROUP_WIDTH = 8;
+#endif
+    static constexpr int BATCH_SIZE = 16; // keys looked up together by find_batch
+    static constexpr size_t INLINE_BYTES = 256;
+    // number of entries stored inside the object before the first allocation, between 1 and the
+    // size of the first segment
+    static constexpr int INLINE_CAPACITY = (int) std::max<size_t>(
+            1, std::min<size_t>(INLINE_BYTES / sizeof(entry), 1 << FIRST_SEGMENT_BITS));
+
+    /**
+     * GROUP_WIDTH consecutive control bytes, compared with a byte all at once: with AVX2 or SSE2
+     * when the compiler targets them, and byte by byte otherwise. A comparison returns a bitmask
+     * whose bit k is set if the k-th byte matches. Groups are aligned to GROUP_WIDTH slots, and
+     * the control array to GROUP_WIDTH bytes, so loading a group never touches 2 cache lines; a
+     * probe sequence starts with the group holding its home slot, ignoring the bytes before it
+     * (see _probedFrom). A table smaller than a group clones its control bytes up to a full group
+     * (see _setCtrl).
+     */
+    struct _Group
+    {
+#if defined(__AVX2__)
+        __m256i ctrl;
+
+        explicit _Group(const ctrl_t *position)
+                : ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(position)))
+        {}
+
+        uint32_t match(ctrl_t value) const
+        {
+            __m256i values = _mm256_set1_epi8(value);
+            return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, values));
+        }
+
+        uint32_t matchFree() const // EMPTY and DELETED are the negative control bytes
+        { return (uint32_t) _mm256_movemask_epi8(ctrl); }
+#elif defined(__SSE2__)
+        __m128i ctrl;
+
+        explicit _Group(const ctrl_t *position)
+                : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(position)))
+        {}
+
+        uint32_t match(ctrl_t value) const
+        { return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value))); }
+
+        uint32_t matchFree() const // EMPTY and DELETED are the negative control bytes
+        { return (uint32_t) _mm_movemask_epi8(ctrl); }
+#else
+        const ctrl_t *ctrl;
+
+        explicit _Group(const ctrl_t *position) : ctrl(position)
+        {}
+
+        uint32_t match(ctrl_t value) const
+        {
+            uint32_t bits = 0;
+            for (int k = 0; k < GROUP_WIDTH; ++k)
+            {
+                bits |= (uint32_t) (ctrl[k] == value) << k;
+            }
+            return bits;
+        }
+
+        uint32_t matchFree() const
+        {
+            uint32_t bits = 0;
+            for (int k = 0; k < GROUP_WIDTH; ++k)
+            {
+                bits |= (uint32_t) (ctrl[k] < 0) << k;
+            }
+            return bits;
+        }
+#endif
+
+        uint32_t matchEmpty() const
+        { return match(EMPTY); }
+    };
+
+#ifdef HASHMAP_ENABLE_STATS
+
+    /**
+     * Counters of HashMapStats. Lookups of a ConcurrentHashMap shard run in several threads at
+     * once, so the counters are relaxed atomics; they are incremented with a load and a store
+     * rather than an atomic addition, which keeps lookups free of locked instructions, at the cost
+     * of losing some increments racing with each other.
+     */
+    struct _Counters
+    {
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> hitProbeGroups{0};
+        std::atomic<uint64_t> missProbeGroups{0};
+        std::atomic<uint64_t> maxHitProbeLength{0};
+        std::atomic<uint64_t> maxMissProbeLength{0};
+        std::atomic<uint64_t> resizes{0};
+        std::atomic<uint64_t> rebuilds{0};
+        std::atomic<uint64_t> reseeds{0};
+        std::atomic<uint64_t> rehashNanoseconds{0};
+        bool timing = false; // a _RehashTimer is running; only changed by writers
+
+        static void add(std::atomic<uint64_t> &counter, uint64_t n)
+        { counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+        static void raise(std::atomic<uint64_t> &counter, uint64_t n)
+        {
+            if (counter.load(std::memory_order_relaxed) < n)
+            {
+                counter.store(n, std::memory_order_relaxed);
+            }
+        }
+
+        static void swap(std::atomic<uint64_t> &a, std::atomic<uint64_t> &b)
+        {
+            uint64_t value = a.load(std::memory_order_relaxed);
+            a.store(b.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            b.store(value, std::memory_order_relaxed);
+        }
+    };
+
+#endif
+
+    /**
+     * Adds the time from its construction to its destruction to the rehash time of a hashmap, when
+     * statistics are enabled. Timers nested in a running one (e.g. the migration of a rehash
+     * within the rehash) do nothing, so no time is counted twice.
+     */
+    class _RehashTimer
+    {
+#ifdef HASHMAP_ENABLE_STATS
+        _Counters *_counters; // nullptr if nested
+        std::chrono::steady_clock::time_point _start;
+
+    public:
+        explicit _RehashTimer(HashMap &map) : _counters(map._counters.timing ? nullptr :
+                                                        &map._counters)
+        {
+            if (_counters != nullptr)
+            {
+                _counters->timing = true;
+                _start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~_RehashTimer()
+        {
+            if (_counters != nullptr)
+            {
+                std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - _start;
+                _Counters::add(_counters->rehashNanoseconds, (uint64_t) elapsed.count());
+                _counters->timing = false;
+            }
+        }
+#else
+    public:
+        explicit _RehashTimer(HashMap &)
+        {}
+#endif
+
+        _RehashTimer(const _RehashTimer &other) = delete;
+
+        _RehashTimer &operator=(const _RehashTimer &other) = delete;
+    };
+
     int _size;
-    int _capacity;
-    double _upperLoadFactor;
-    double _lowerLoadFactor;
-    bucket *_bucketsArray;
+    int _capacity; // number of slots of the index table
+    int _deleted; // number of DELETED control bytes (tombstones) currently in the table
+    HashMapResizePolicy _policy;
+    int _underloadedErases; // consecutive erases which left the table under the lower load factor
+    entry *_segments[MAX_SEGMENTS]; // entries [0, _size), see _entryAt
+    int _segmentCount; // number of allocated segments
+    ctrl_t *_ctrl; // control byte of every slot; nullptr while the entries are inline
+    int *_index; // entry of every full slot
+    int _rehashStep; // old slots migrated per insert/erase while rehashing; 0 rehashes at once
+    ctrl_t *_oldCtrl; // control bytes of the table being migrated from; nullptr if not rehashing
+    int *_oldIndex; // entries of the slots of the table being migrated from
+    int _oldCapacity; // capacity of the table being migrated from; 0 if not rehashing
+    int _migrated; // number of slots of the old table already migrated
+    int _insertsSinceReseed; // a reseed must be paid for by about as many inserts as there were
+    // elements at the last one
+    Hash _hashFunction;
+    KeyEqual _keyEqual;
+    Allocator _allocator;
+#ifdef HASHMAP_ENABLE_STATS
+    mutable _Counters _counters; // zeroed in copies, carried by moves and swaps
+#endif
+    alignas(entry) unsigned char _inline[INLINE_CAPACITY * sizeof(entry)]; // entries of a small map
 
 // ================================ PRIVATE HELPER METHODS =======================================
 
 
     /**
      * Performs hashing on a key.
-     * @param key key of KeyT value
-     * @return hashed index
+     * @param key key of KeyT value, or of a type transparently comparable with KeyT
+     * @return full hash of the key
      */
-    int _hash(KeyT key) const
+    template<typename K>
+    size_t _hash(const K &key) const
     {
-        return std::hash<KeyT>()(key) & (_capacity - 1);
+        return _hashFunction(key);
     }
 
     /**
-     * @return true if the lower load factor requires resizing the table; false otherwise.
+     * @param hash full hash of a key
+     * @return home slot of the hash, i.e. the first slot of its probe sequence.
      */
-    bool _checkLowerLoadFactor() const
+    int _home(size_t hash) const
     {
-        return (getLoadFactor() < _lowerLoadFactor);
+        return (int) (hash & (size_t) (_capacity - 1));
     }
 
     /**
-     * @return true if after adding element, the upper load factor requires resizing the table;
-     * false otherwise.
+     * @param hash full hash of a key
+     * @return control byte stored for the key, the 7 high bits of its hash.
      */
-    bool _checkUpperLoadFactor() const
+    static ctrl_t _tag(size_t hash)
     {
-        return (((double) (_size + 1) / (double) _capacity) > _upperLoadFactor);
+        return (ctrl_t) (hash >> (sizeof(size_t) * 8 - 7));
     }
 
     /**
-     * Performs rehashing and increasing/decreasing the table;
-     * @param command 1 for increase, -1 for decrease;
+     * @param ctrl control byte
+     * @return true if the slot of the control byte holds a pair; false otherwise.
      */
-    void _rehashManager(int command)
+    static bool _isFull(ctrl_t ctrl)
     {
-        int oldCapacity = _capacity;
-        if (command == 1)
+        return ctrl >= 0;
+    }
+
+    /**
+     * Hints the processor to fetch an address into the cache, without waiting for it.
+     * @param address address to be read soon
+     */
+    static void _prefetch(const void *address)
+    {
+#ifdef __GNUC__
+        __builtin_prefetch(address);
+#else
+        (void) address;
+#endif
+    }
+
+    /**
+     * Counts a lookup, when statistics are enabled.
+     * @param hit true if the lookup found its key; false otherwise.
+     * @param groups number of groups the lookup probed
+     */
+    void _countLookup(bool hit, int groups) const
+    {
+#ifdef HASHMAP_ENABLE_STATS
+        _Counters::add(hit ? _counters.hits : _counters.misses, 1);
+        _Counters::add(hit ? _counters.hitProbeGroups : _counters.missProbeGroups,
+                       (uint64_t) groups);
+        _Counters::raise(hit ? _counters.maxHitProbeLength : _counters.maxMissProbeLength,
+                         (uint64_t) groups);
+#else
+        (void) hit;
+        (void) groups;
+#endif
+    }
+
+    /**
+     * Counts a rehash, when statistics are enabled.
+     * @param resize true if the table gets a new capacity; false if it is rebuilt in its capacity
+     */
+    void _countRehash(bool resize)
+    {
+#ifdef HASHMAP_ENABLE_STATS
+        _Counters::add(resize ? _counters.resizes : _counters.rebuilds, 1);
+#else
+        (void) resize;
+#endif
+    }
+
+    /**
+     * @param bits non-zero bitmask
+     * @return index of the lowest set bit.
+     */
+    static int _lowestBit(uint32_t bits)
+    {
+#ifdef __GNUC__
+        return __builtin_ctz(bits);
+#else
+        int index = 0;
+        while ((bits & 1) == 0)
         {
-            _capacity *= 2;
+            bits >>= 1;
+            ++index;
         }
-        if (command == -1)
+        return index;
+#endif
+    }
+
+    /**
+     * @param home home slot of a probe sequence
+     * @return first slot of the group holding home.
+     */
+    static int _groupOf(int home)
+    {
+        return home & ~(GROUP_WIDTH - 1);
+    }
+
+    /**
+     * @param home home slot of a probe sequence
+     * @return bitmask of the bytes of the group of home which are on the probe sequence, i.e.
+     * home and the following ones.
+     */
+    static uint32_t _probedFrom(int home)
+    {
+        return ~0u << (home & (GROUP_WIDTH - 1));
+    }
+
+    /**
+     * @param capacity number of slots
+     * @return number of control bytes of a table: a full group for tables smaller than a group.
+     */
+    static size_t _ctrlBytes(int capacity)
+    {
+        return (size_t) std::max(capacity, GROUP_WIDTH);
+    }
+
+    /**
+     * Sets a control byte. A table smaller than a group fills the rest of its group with clones,
+     * slot i being cloned at i + capacity, i + 2 * capacity, ..., so the group starting at slot 0
+     * holds the whole probe sequence of any home slot, in order.
+     * @param ctrl control array of a table
+     * @param capacity number of slots of the table
+     * @param i index of a slot
+     * @param value new control byte of the slot
+     */
+    static void _setCtrl(ctrl_t *ctrl, int capacity, int i, ctrl_t value)
+    {
+        ctrl[i] = value;
+        for (int clone = i + capacity; clone < GROUP_WIDTH; clone += capacity)
         {
-            _capacity /= 2;
+            ctrl[clone] = value;
         }
-        bucket *temp;
-        try
+    }
+
+    /**
+     * @param x positive number
+     * @return floor(log2(x)).
+     */
+    static int _log2(unsigned int x)
+    {
+#ifdef __GNUC__
+        return std::numeric_limits<unsigned int>::digits - 1 - __builtin_clz(x);
+#else
+        int log = 0;
+        while (x >>= 1)
+        {
+            ++log;
+        }
+        return log;
+#endif
+    }
+
+    /**
+     * @param segments number of segments
+     * @return number of entries the given number of segments hold.
+     */
+    static int _segmentsCapacity(int segments)
+    {
+        return segments == 0 ? 0 : 1 << (FIRST_SEGMENT_BITS + segments - 1);
+    }
+
+    /**
+     * Entries are stored in segments which double in size: segment 0 holds entries [0, 16),
+     * and segment s > 0 holds entries [2^(s+3), 2^(s+4)). Adding a segment never moves the entries
+     * already stored, so growing the hashmap only reallocates the index table.
+     * @param e index of an entry
+     * @return the entry
+     */
+    entry &_entryAt(int e) const
+    {
+        if (e < (1 << FIRST_SEGMENT_BITS))
         {
-            temp = new bucket[_capacity];
+            return _segments[0][e];
         }
-        catch (std::bad_alloc &e)
+        int top = _log2((unsigned int) e);
+        return _segments[top - FIRST_SEGMENT_BITS + 1][e - (1 << top)];
+    }
+
+    /**
+     * @return the inline entries, which are the first segment while there is no index table.
+     */
+    entry *_inlineEntries()
+    {
+        return reinterpret_cast<entry *>(_inline);
+    }
+
+    /**
+     * Moves an entry to uninitialized memory, and destroys it.
+     * @param from entry to move
+     * @param to memory to move it to
+     */
+    static void _relocate(entry &from, entry *to) noexcept
+    {
+        new(to) entry(std::move(from));
+        from.~entry();
+    }
+
+    /**
+     * Allocates the next segment if all the segments are full; inline entries need none.
+     */
+    void _reserveEntry()
+    {
+        if (_ctrl != nullptr && _size == _segmentsCapacity(_segmentCount))
         {
-            delete[] _bucketsArray;
-            throw std::bad_alloc();
+            int length = _segmentCount == 0 ? 1 << FIRST_SEGMENT_BITS : _size;
+            _segments[_segmentCount] = entryAllocator(_allocator).allocate(length);
+            ++_segmentCount;
         }
-        for (int i = 0; i < oldCapacity; ++i)
+    }
+
+    /**
+     * Frees the trailing segments which are not needed to hold the given number of entries.
+     * @param count number of entries to keep room for, at least the size of the hashmap
+     */
+    void _trimSegments(int count) noexcept
+    {
+        while (_segmentCount > 0 && _segmentsCapacity(_segmentCount - 1) >= count)
         {
-            for (pair p : _bucketsArray[i])
-            {
-                temp[i].push_back(p);
-            }
+            --_segmentCount;
+            int length = _segmentsCapacity(_segmentCount + 1) - _segmentsCapacity(_segmentCount);
+            entryAllocator(_allocator).deallocate(_segments[_segmentCount], length);
         }
-        delete[] _bucketsArray;
-        _bucketsArray = temp;
     }
 
     /**
-    * Finds the cell of the key and returns a reference to its value; assumes key is in hashmap.
-    * @param key key in hashmap
-    * @return reference to value
-    */
-    ValueT &_findCell(const KeyT &key) const
+     * A table is only halved if its elements still respect the upper load factor afterwards
+     * (less the hysteresis of the resize policy), since an open addressing table can not hold more
+     * elements than slots, and never below the minimal capacity of the policy.
+     * @return true if the lower load factor requires resizing the table; false otherwise.
+     */
+    bool _checkLowerLoadFactor() const
+    {
+        return (getLoadFactor() < _policy.lowerLoadFactor && _capacity / 2 >= _policy.minCapacity &&
+                (double) _size / (double) (_capacity / 2) <=
+                _policy.upperLoadFactor * (1 - _policy.shrinkHysteresis));
+    }
+
+    /**
+     * @return true if after adding element, the upper load factor requires resizing the table;
+     * false otherwise.
+     */
+    bool _checkUpperLoadFactor() const
+    {
+        return (((double) (_size + 1) / (double) _capacity) > _policy.upperLoadFactor);
+    }
+
+    /**
+     * Tombstones lengthen probe sequences just like elements do, so they are counted as well when
+     * deciding whether the table must be rebuilt; this also guarantees every probe sequence meets
+     * an EMPTY slot and terminates.
+     * @return true if after adding element, elements and tombstones together exceed the upper
+     * load factor; false otherwise.
+     */
+    bool _checkTombstones() const
+    {
+        return (((double) (_size + _deleted + 1) / (double) _capacity) >
+                _policy.upperLoadFactor);
+    }
+
+    /**
+     * @param capacity number of slots
+     * @return number of ints allocated for an index table of the given capacity: an entry index
+     * for every slot, then the control bytes, aligned to GROUP_WIDTH.
+     */
+    static size_t _indexLength(int capacity)
+    {
+        size_t bytes = (size_t) capacity * sizeof(int) + GROUP_WIDTH - 1 + _ctrlBytes(capacity);
+        return (bytes + sizeof(int) - 1) / sizeof(int);
+    }
+
+    /**
+     * Allocates an index table of the given capacity, all slots empty. The entry indices and the
+     * control bytes share a single allocation, owned by index.
+     * @param capacity number of slots
+     * @param ctrl output control array
+     * @param index output entry index array
+     */
+    void _allocateIndex(int capacity, ctrl_t *&ctrl, int *&index)
+    {
+        index = indexAllocator(_allocator).allocate(_indexLength(capacity));
+        uintptr_t end = reinterpret_cast<uintptr_t>(index + capacity);
+        ctrl = reinterpret_cast<ctrl_t *>((end + GROUP_WIDTH - 1) & ~(uintptr_t) (GROUP_WIDTH - 1));
+        std::memset(ctrl, EMPTY, _ctrlBytes(capacity));
+    }
+
+    /**
+     * Frees an index table.
+     * @param index entry index array of the table, may be nullptr
+     * @param capacity number of slots of the table
+     */
+    void _freeIndex(int *index, int capacity) noexcept
+    {
+        if (index != nullptr)
+        {
+            indexAllocator(_allocator).deallocate(index, _indexLength(capacity));
+        }
+    }
+
+    /**
+     * Moves the inline entries into a first segment and indexes them in a new table, before the
+     * hashmap grows past its inline entries.
+     * @param capacity capacity of the new table, large enough for the entries
+     */
+    void _leaveInline(int capacity)
+    {
+        ctrl_t *ctrl;
+        int *index;
+        _RehashTimer timer(*this);
+        _countRehash(true);
+        _allocateIndex(capacity, ctrl, index);
+        entry *segment;
+        try
+        {
+            segment = entryAllocator(_allocator).allocate(1 << FIRST_SEGMENT_BITS);
+        }
+        catch (...)
+        {
+            _freeIndex(index, capacity);
+            throw;
+        }
+        for (int e = 0; e < _size; ++e)
+        {
+            _relocate(_segments[0][e], segment + e);
+        }
+        _segments[0] = segment;
+        _segmentCount = 1;
+        _ctrl = ctrl;
+        _index = index;
+        _capacity = capacity;
+        _rebuildIndex();
+    }
+
+    /**
+     * Destroys all the entries and frees the segments and the index tables.
+     */
+    void _freeTables() noexcept
+    {
+        for (int e = 0; e < _size; ++e)
+        {
+            _entryAt(e).~entry();
+        }
+        _trimSegments(0);
+        _freeIndex(_index, _capacity);
+        _freeIndex(_oldIndex, _oldCapacity);
+        _ctrl = _oldCtrl = nullptr;
+        _index = _oldIndex = nullptr;
+        _oldCapacity = 0;
+        _migrated = 0;
+    }
+
+    /**
+     * Finds the slot holding a key in an index table.
+     * @param ctrl control array of the table, may be nullptr
+     * @param index entry index array of the table
+     * @param capacity number of slots of the table
+     * @param key key to look for
+     * @param hash full hash of key
+     * @param groups if not nullptr, incremented by the number of groups probed when statistics
+     * are enabled
+     * @return index of the slot holding key if key exists; -1 otherwise.
+     */
+    template<typename K>
+    int _probe(const ctrl_t *ctrl, const int *index, int capacity, const K &key,
+               size_t hash, int *groups = nullptr) const
+    {
+#ifndef HASHMAP_ENABLE_STATS
+        (void) groups;
+#endif
+        if (ctrl == nullptr)
+        {
+            return -1;
+        }
+        ctrl_t tag = _tag(hash);
+        int mask = capacity - 1;
+        int home = (int) (hash & (size_t) mask);
+        // the key is most likely in its home slot: its index is fetched along with its group,
+        // rather than after the group is compared
+        _prefetch(index + home);
+        uint32_t probed = _probedFrom(home);
+        for (int i = _groupOf(home);; i = (i + GROUP_WIDTH) & mask, probed = ~0u)
+        {
+            _Group group(ctrl + i);
+#ifdef HASHMAP_ENABLE_STATS
+            if (groups != nullptr)
+            {
+                ++*groups;
+            }
+#endif
+            for (uint32_t match = group.match(tag) & probed; match != 0; match &= match - 1)
+            {
+                int slot = (i + _lowestBit(match)) & mask;
+                const entry &candidate = _entryAt(index[slot]);
+                if (candidate.hash == hash && _keyEqual(candidate.kv.first, key))
+                {
+                    return slot;
+                }
+            }
+            if ((group.matchEmpty() & probed) != 0) // the probe sequence ends in this group
+            {
+                return -1;
+            }
+        }
+    }
+
+    /**
+     * Finds the slot holding a key in the current table.
+     * @param key key to look for
+     * @param hash full hash of key
+     * @return index of the slot holding key if key exists; -1 otherwise.
+     */
+    template<typename K>
+    int _findIndex(const K &key, size_t hash) const
+    {
+        return _probe(_ctrl, _index, _capacity, key, hash);
+    }
+
+    /**
+     * Searches the inline entries linearly, comparing full hashes before keys.
+     * @param key key to look for
+     * @param hash full hash of key
+     * @return index of the entry of key if key exists; -1 otherwise.
+     */
+    template<typename K>
+    int _scanInline(const K &key, size_t hash) const
+    {
+        for (int e = 0; e < _size; ++e)
+        {
+            const entry &candidate = _segments[0][e];
+            if (candidate.hash == hash && _keyEqual(candidate.kv.first, key))
+            {
+                return e;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * Finds the entry of a key; while rehashing incrementally, its slot may still be in the old
+     * table.
+     * @param key key to look for
+     * @param hash full hash of key
+     * @return index of the entry of key if key exists; -1 otherwise.
+     */
+    template<typename K>
+    int _findEntry(const K &key, size_t hash) const
+    {
+        int e;
+        int groups = 1; // the inline entries count as a single group
+        if (_ctrl == nullptr)
+        {
+            e = _scanInline(key, hash);
+        }
+        else
+        {
+            groups = 0;
+            int idx = _probe(_ctrl, _index, _capacity, key, hash, &groups);
+            if (idx != -1)
+            {
+                e = _index[idx];
+            }
+            else
+            {
+                idx = _probe(_oldCtrl, _oldIndex, _oldCapacity, key, hash, &groups);
+                e = idx == -1 ? -1 : _oldIndex[idx];
+            }
+        }
+        _countLookup(e != -1, groups);
+        return e;
+    }
+
+    /**
+     * Shared implementation of the find_batch overloads. Looking keys up one by one, each lookup
+     * waits for its slot, then for its entry, to arrive from memory before the next one starts.
+     * Here the keys are looked up in groups of BATCH_SIZE, in three passes over each group, so the
+     * memory accesses of the whole group overlap: first every key is hashed and its home slot
+     * prefetched; then the first slot of its home group matching the tag of every key is found,
+     * and its entry prefetched; only then are the keys compared.
+     * @param keys array of count keys
+     * @param count number of keys
+     * @param values output - array of count pointers, set to the value of every key, or nullptr
+     * @return number of keys found.
+     */
+    template<typename K, typename V>
+    int _findBatch(const K *keys, size_t count, V **values) const
+    {
+        size_t hashes[BATCH_SIZE];
+        int found = 0;
+        for (size_t first = 0; first < count; first += BATCH_SIZE)
+        {
+            size_t length = std::min(count - first, (size_t) BATCH_SIZE);
+            for (size_t i = 0; i < length; ++i)
+            {
+                hashes[i] = _hash(keys[first + i]);
+                if (_ctrl != nullptr)
+                {
+                    _prefetch(_ctrl + _groupOf(_home(hashes[i])));
+                    _prefetch(_index + _home(hashes[i]));
+                }
+            }
+            for (size_t i = 0; i < length && _ctrl != nullptr; ++i)
+            {
+                int home = _home(hashes[i]);
+                int group = _groupOf(home);
+                uint32_t match = _Group(_ctrl + group).match(_tag(hashes[i])) & _probedFrom(home);
+                if (match != 0)
+                {
+                    _prefetch(&_entryAt(_index[(group + _lowestBit(match)) & (_capacity - 1)]));
+                }
+            }
+            for (size_t i = 0; i < length; ++i)
+            {
+                int e = _findEntry(keys[first + i], hashes[i]);
+                values[first + i] = e == -1 ? nullptr : &_entryAt(e).kv.second;
+                found += e != -1;
+            }
+        }
+        return found;
+    }
+
+    /**
+     * Finds the slot referring to an entry in an index table.
+     * @param ctrl control array of the table, may be nullptr
+     * @param index entry index array of the table
+     * @param capacity number of slots of the table
+     * @param e index of an entry
+     * @param hash full hash of the key of the entry
+     * @return index of the slot referring to e if there is one; -1 otherwise.
+     */
+    static int _probeEntry(const ctrl_t *ctrl, const int *index, int capacity, int e,
+                           size_t hash)
+    {
+        if (ctrl == nullptr)
+        {
+            return -1;
+        }
+        ctrl_t tag = _tag(hash);
+        int mask = capacity - 1;
+        int home = (int) (hash & (size_t) mask);
+        uint32_t probed = _probedFrom(home);
+        for (int i = _groupOf(home);; i = (i + GROUP_WIDTH) & mask, probed = ~0u)
+        {
+            _Group group(ctrl + i);
+            for (uint32_t match = group.match(tag) & probed; match != 0; match &= match - 1)
+            {
+                int slot = (i + _lowestBit(match)) & mask;
+                if (index[slot] == e)
+                {
+                    return slot;
+                }
+            }
+            if ((group.matchEmpty() & probed) != 0)
+            {
+                return -1;
+            }
+        }
+    }
+
+    /**
+     * Finds the first slot on the probe sequence of a hash which can receive a new pair.
+     * @param hash full hash of the key to insert
+     * @return index of the first EMPTY or DELETED slot on the probe sequence.
+     */
+    int _findFreeIndex(size_t hash) const
+    {
+        int mask = _capacity - 1;
+        uint32_t probed = _probedFrom(_home(hash));
+        for (int i = _groupOf(_home(hash));; i = (i + GROUP_WIDTH) & mask, probed = ~0u)
+        {
+            uint32_t free = _Group(_ctrl + i).matchFree() & probed;
+            if (free != 0)
+            {
+                return (i + _lowestBit(free)) & mask;
+            }
+        }
+    }
+
+    /**
+     * Makes a free slot of the current table refer to an entry.
+     * @param idx index of a free slot on the probe sequence of the entry
+     * @param e index of the entry
+     * @param hash full hash of the key of the entry
+     */
+    void _place(int idx, int e, size_t hash)
+    {
+        if (_ctrl[idx] == DELETED)
+        {
+            --_deleted;
+        }
+        _setCtrl(_ctrl, _capacity, idx, _tag(hash));
+        _index[idx] = e;
+    }
+
+    /**
+     * Moves a slot of the old table into a free slot of the current table.
+     * @param oldIdx index of a full slot of the old table
+     * @param idx index of a free slot of the current table on the probe sequence of its entry
+     * @param hash full hash of the key of its entry
+     */
+    void _moveFromOld(int oldIdx, int idx, size_t hash)
+    {
+        _place(idx, _oldIndex[oldIdx], hash);
+        _setCtrl(_oldCtrl, _oldCapacity, oldIdx, DELETED); // keeps the old probe sequences intact
+    }
+
+    /**
+     * Migrates the next slots of the old table into the current table, and frees the old table
+     * once all of its slots were migrated.
+     * @param count maximal number of old slots to migrate
+     */
+    void _migrate(int count)
+    {
+        if (_oldCtrl == nullptr)
+        {
+            return;
+        }
+        _RehashTimer timer(*this);
+        for (; count > 0 && _migrated < _oldCapacity; --count, ++_migrated)
+        {
+            if (_isFull(_oldCtrl[_migrated]))
+            {
+                size_t hash = _entryAt(_oldIndex[_migrated]).hash;
+                _moveFromOld(_migrated, _findFreeIndex(hash), hash);
+            }
+        }
+        if (_migrated == _oldCapacity)
+        {
+            _freeIndex(_oldIndex, _oldCapacity);
+            _oldCtrl = nullptr;
+            _oldIndex = nullptr;
+            _oldCapacity = 0;
+            _migrated = 0;
+        }
+    }
+
+    /**
+     * Performs rehashing and increasing/decreasing the table; every entry gets its slot according
+     * to the new capacity, and tombstones are dropped. The entries themselves stay where they are,
+     * and their stored hashes are reused, so no key is hashed or moved. If a rehash step was set,
+     * only that many slots are migrated now, and the rest are migrated by the following inserts and
+     * erases, so no single operation pays for the whole table.
+     * @param command 1 for increase, -1 for decrease, 0 for rebuilding in the same capacity;
+     */
+    void _rehashManager(int command)
+    {
+        int newCapacity = _capacity;
+        if (command == 1)
+        {
+            newCapacity *= 2;
+        }
+        if (command == -1 && _capacity > 1)
+        {
+            newCapacity /= 2;
+        }
+        _rehashTo(newCapacity);
+    }
+
+    /**
+     * Rehashes the table into a table of the given capacity, as described in _rehashManager.
+     * Inline entries have no table to rehash, only their capacity changes.
+     * @param newCapacity capacity of the new table, a power of 2 large enough for all elements
+     */
+    void _rehashTo(int newCapacity)
+    {
+        if (_ctrl == nullptr)
+        {
+            _capacity = newCapacity;
+            return;
+        }
+        _RehashTimer timer(*this);
+        _countRehash(newCapacity != _capacity);
+        _migrate(_oldCapacity); // a previous rehash must be completed first
+        ctrl_t *newCtrl;
+        int *newIndex;
+        _allocateIndex(newCapacity, newCtrl, newIndex); // on failure, the table is unchanged
+        bool shrinking = newCapacity < _capacity;
+        if (_rehashStep == 0)
+        {
+            _freeIndex(_index, _capacity);
+            _ctrl = newCtrl;
+            _index = newIndex;
+            _capacity = newCapacity;
+            _rebuildIndex();
+        }
+        else
+        {
+            _oldCtrl = _ctrl;
+            _oldIndex = _index;
+            _oldCapacity = _capacity;
+            _migrated = 0;
+            _ctrl = newCtrl;
+            _index = newIndex;
+            _capacity = newCapacity;
+            _deleted = 0;
+            _migrate(_rehashStep);
+        }
+        if (shrinking)
+        {
+            _trimSegments(std::max(_size, (int) (_capacity * _policy.upperLoadFactor)));
+        }
+    }
+
+    /**
+     * Rebuilds the current table in place from the entries, which are not rehashed: tombstones
+     * become EMPTY again, and every entry gets the first free slot of its probe sequence.
+     */
+    void _rebuildIndex()
+    {
+        std::memset(_ctrl, EMPTY, _ctrlBytes(_capacity));
+        _deleted = 0;
+        for (int e = 0; e < _size; ++e)
+        {
+            size_t hash = _entryAt(e).hash;
+            _place(_findFreeIndex(hash), e, hash);
+        }
+    }
+
+    /**
+     * @param count number of elements
+     * @param minCapacity minimal capacity
+     * @return the smallest power of 2 which is at least minCapacity and the minimal capacity of the
+     * resize policy, and large enough to hold count elements without exceeding the upper load
+     * factor.
+     */
+    int _capacityFor(size_t count, size_t minCapacity = 1) const
+    {
+        minCapacity = std::max(minCapacity, (size_t) _policy.minCapacity);
+        size_t capacity = 1;
+        while (capacity < minCapacity ||
+               (double) count / (double) capacity > _policy.upperLoadFactor)
+        {
+            if (capacity > (size_t) std::numeric_limits<int>::max() / 2)
+            {
+                throw std::length_error("HashMap capacity overflow");
+            }
+            capacity *= 2;
+        }
+        return (int) capacity;
+    }
+
+    /**
+     * Enables the iterator range constructors only for iterator types.
+     */
+    template<typename Iter>
+    using _enableIfIterator = typename std::enable_if<std::is_convertible<
+            typename std::iterator_traits<Iter>::iterator_category,
+            std::input_iterator_tag>::value, int>::type;
+
+    /**
+     * @return the length of the range [first, last) if it can be computed without consuming the
+     * range, i.e. for forward iterators; 0 otherwise.
+     */
+    template<typename Iter>
+    static size_t _rangeLength(Iter first, Iter last)
+    {
+        if (std::is_convertible<typename std::iterator_traits<Iter>::iterator_category,
+                std::forward_iterator_tag>::value)
+        {
+            return (size_t) std::distance(first, last);
+        }
+        return 0;
+    }
+
+    /**
+     * @return capacity of a new hashmap
+     */
+    int _initialCapacity() const
+    {
+        return _capacityFor(0, INITIAL_CAPACITY);
+    }
+
+    /**
+     * Frees a slot of the current table. If the next slot is EMPTY, no probe sequence continues
+     * through this slot, so it (and the run of tombstones preceding it) becomes EMPTY again instead
+     * of a tombstone.
+     * @param idx index of a full slot
+     */
+    void _eraseIndex(int idx)
+    {
+        int mask = _capacity - 1;
+        if (_ctrl[(idx + 1) & mask] != EMPTY)
+        {
+            _setCtrl(_ctrl, _capacity, idx, DELETED);
+            ++_deleted;
+            return;
+        }
+        _setCtrl(_ctrl, _capacity, idx, EMPTY);
+        for (int i = (idx - 1) & mask; _ctrl[i] == DELETED; i = (i - 1) & mask)
+        {
+            _setCtrl(_ctrl, _capacity, i, EMPTY);
+            --_deleted;
+        }
+    }
+
+    /**
+     * Destroys an entry whose slot was freed, and moves the last entry into its place so that the
+     * entries stay dense; the slot referring to the last entry is updated accordingly.
+     * @param e index of the entry
+     */
+    void _removeEntry(int e)
+    {
+        int last = _size - 1;
+        entry &hole = _entryAt(e);
+        hole.~entry();
+        if (e != last)
+        {
+            _relocate(_entryAt(last), &hole);
+            if (_ctrl == nullptr) // inline entries have no slot
+            {
+                --_size;
+                return;
+            }
+            int idx = _probeEntry(_ctrl, _index, _capacity, last, hole.hash);
+            if (idx != -1)
+            {
+                _index[idx] = e;
+            }
+            else
+            {
+                _oldIndex[_probeEntry(_oldCtrl, _oldIndex, _oldCapacity, last, hole.hash)] = e;
+            }
+        }
+        --_size;
+    }
+
+    /**
+     * @param groups number of groups probed by an insertion
+     * @return true if the probe is longer than the resize policy allows, and the hash function
+     * can be reseeded, and enough inserts happened since the last reseed that reseeding again
+     * costs O(1) amortized per insert, even if the keys collide whatever the seed.
+     */
+    bool _floodDetected(int groups) const
+    {
+        return _isReseedable<Hash>::value && _policy.maxProbeLength != 0 &&
+               groups > _policy.maxProbeLength / GROUP_WIDTH && _insertsSinceReseed >= _size / 2;
+    }
+
+    /**
+     * Reseeds the hash function and rehashes every key with it, rebuilding the table in the same
+     * capacity; crafted colliding keys are scattered by the new seed.
+     */
+    void _reseed()
+    {
+        if constexpr (_isReseedable<Hash>::value)
+        {
+            _migrate(_oldCapacity);
+            _RehashTimer timer(*this);
+#ifdef HASHMAP_ENABLE_STATS
+            _Counters::add(_counters.reseeds, 1);
+#endif
+            _hashFunction.reseed();
+            for (int e = 0; e < _size; ++e)
+            {
+                _entryAt(e).hash = _hash(_entryAt(e).kv.first);
+            }
+            _rebuildIndex();
+            _insertsSinceReseed = 0;
+        }
+    }
+
+    /**
+     * Looks a key up and, if it is missing, prepares a slot for it, in a single probe sequence:
+     * while searching for the key, the first tombstone on the way is remembered, so unless the
+     * table has to be resized, the slot to insert into is known once the search is over.
+     * If the probe sequence was over-long (see _floodDetected), the hash function is reseeded
+     * before the insertion, which changes the hash of key.
+     * @param key key to look for
+     * @param hash input - full hash of key; output - its hash after a reseed
+     * @param found output - true if key exists in hashmap; false otherwise.
+     * @return index of the entry of key if found; else, index of a free slot on the probe
+     * sequence of key (possibly in a resized table), or -1 if it is inserted inline, to be filled
+     * by _constructAt.
+     */
+    int _findOrPrepareInsert(const KeyT &key, size_t &hash, bool &found)
+    {
+        if (_ctrl == nullptr)
+        {
+            int e = _scanInline(key, hash);
+            found = e != -1;
+            if (found)
+            {
+                return e;
+            }
+            if (_size < INLINE_CAPACITY)
+            {
+                _underloadedErases = 0;
+                if (_checkUpperLoadFactor())
+                {
+                    _rehashManager(1);
+                }
+                return -1;
+            }
+            _leaveInline(_capacity);
+        }
+        _migrate(_rehashStep);
+        ctrl_t tag = _tag(hash);
+        int mask = _capacity - 1;
+        int firstDeleted = -1;
+        _prefetch(_index + _home(hash)); // see _probe
+        uint32_t probed = _probedFrom(_home(hash));
+        int i = _groupOf(_home(hash));
+        int groups = 1;
+        for (;; i = (i + GROUP_WIDTH) & mask, probed = ~0u, ++groups)
+        {
+            _Group group(_ctrl + i);
+            for (uint32_t match = group.match(tag) & probed; match != 0; match &= match - 1)
+            {
+                int slot = (i + _lowestBit(match)) & mask;
+                const entry &candidate = _entryAt(_index[slot]);
+                if (candidate.hash == hash && _keyEqual(candidate.kv.first, key))
+                {
+                    found = true;
+                    return _index[slot];
+                }
+            }
+            uint32_t empty = group.matchEmpty() & probed;
+            // only the tombstones before the first EMPTY slot are on the probe sequence
+            uint32_t deleted = group.match(DELETED) & probed &
+                               (empty == 0 ? ~0u : (empty & -empty) - 1);
+            if (firstDeleted == -1 && deleted != 0)
+            {
+                firstDeleted = (i + _lowestBit(deleted)) & mask;
+            }
+            if (empty != 0)
+            {
+                i = (i + _lowestBit(empty)) & mask;
+                break;
+            }
+        }
+        int oldIdx = _probe(_oldCtrl, _oldIndex, _oldCapacity, key, hash);
+        if (oldIdx != -1) // not migrated yet, migrate it now into the slot found for it
+        {
+            _moveFromOld(oldIdx, firstDeleted != -1 ? firstDeleted : i, hash);
+            found = true;
+            return _oldIndex[oldIdx];
+        }
+        found = false;
+        _underloadedErases = 0;
+        if (_floodDetected(groups))
+        {
+            _reseed();
+            hash = _hash(key);
+            if (_checkUpperLoadFactor())
+            {
+                _rehashManager(1);
+            }
+            return _findFreeIndex(hash);
+        }
+        if (_checkUpperLoadFactor())
+        {
+            _rehashManager(1);
+            return _findFreeIndex(hash);
+        }
+        if (firstDeleted != -1) // reusing a tombstone does not lengthen any probe sequence
+        {
+            return firstDeleted;
+        }
+        if (_checkTombstones())
+        {
+            if (_rehashStep == 0 && _oldCtrl == nullptr)
+            {
+                _RehashTimer timer(*this);
+                _countRehash(false);
+                _rebuildIndex(); // steady insert/erase churn never reallocates the table
+            }
+            else
+            {
+                _rehashManager(0);
+            }
+            return _findFreeIndex(hash);
+        }
+        return i;
+    }
+
+    /**
+     * Appends an entry constructed from args, and makes a free slot returned by
+     * _findOrPrepareInsert refer to it.
+     * @param idx index of a free slot
+     * @param hash full hash of the key
+     * @param args arguments forwarded to the constructor of the pair
+     * @return index of the new entry
+     */
+    template<typename... Args>
+    int _constructAt(int idx, size_t hash, Args &&... args)
+    {
+        _reserveEntry();
+        new(&_entryAt(_size)) entry(hash, std::forward<Args>(args)...);
+        if (_ctrl != nullptr)
+        {
+            _place(idx, _size, hash);
+        }
+        if (_insertsSinceReseed < std::numeric_limits<int>::max())
+        {
+            ++_insertsSinceReseed;
+        }
+        return _size++;
+    }
+
+    /**
+     * @param key key to look for
+     * @return index of the entry of key if key exists; throws std::out_of_range otherwise.
+     */
+    template<typename K>
+    int _existingEntry(const K &key) const
+    {
+        int e = _findEntry(key, _hash(key));
+        if (e == -1)
+        {
+            throw std::out_of_range("Invalid key");
+        }
+        return e;
+    }
+
+    /**
+     * Shared implementation of both erase overloads.
+     * @param key key to remove
+     * @param hash full hash of key
+     * @return true if key was successfully was erased; false otherwise.
+     */
+    template<typename K>
+    bool _erase(const K &key, size_t hash)
+    {
+        _migrate(_rehashStep);
+        int idx = _findIndex(key, hash);
+        int e;
+        if (_ctrl == nullptr)
+        {
+            e = _scanInline(key, hash);
+            if (e == -1)
+            {
+                return false;
+            }
+        }
+        else if (idx != -1)
+        {
+            e = _index[idx];
+            _eraseIndex(idx);
+        }
+        else
+        {
+            idx = _probe(_oldCtrl, _oldIndex, _oldCapacity, key, hash);
+            if (idx == -1)
+            {
+                return false;
+            }
+            e = _oldIndex[idx];
+            _setCtrl(_oldCtrl, _oldCapacity, idx, DELETED);
+        }
+        _removeEntry(e);
+        if (!_checkLowerLoadFactor())
+        {
+            _underloadedErases = 0;
+        }
+        else if (++_underloadedErases > _policy.shrinkDelay)
+        {
+            _underloadedErases = 0;
+            _rehashManager(-1);
+        }
+        return true;
+    }
+
+    /**
+     * Shared implementation of both try_emplace overloads.
+     * @param key key, forwarded into the new pair if inserted
+     * @param args arguments forwarded to the constructor of the value if inserted
+     * @return iterator to the pair of key, and true if insertion was performed.
+     */
+    template<typename K, typename... Args>
+    std::pair<iterator, bool> _tryEmplace(K &&key, Args &&... args)
+    {
+        size_t hash = _hash(key);
+        bool found;
+        int e = _findOrPrepareInsert(key, hash, found);
+        if (!found)
+        {
+            e = _constructAt(e, hash, std::piecewise_construct,
+                             std::forward_as_tuple(std::forward<K>(key)),
+                             std::forward_as_tuple(std::forward<Args>(args)...));
+        }
+        return {iterator(this, e), !found};
+    }
+
+    /**
+     * Shared implementation of both insert_or_assign overloads.
+     * @param key key, forwarded into the new pair if inserted
+     * @param value value to assign or insert
+     * @return iterator to the pair of key, and true if insertion was performed.
+     */
+    template<typename K, typename M>
+    std::pair<iterator, bool> _insertOrAssign(K &&key, M &&value)
+    {
+        size_t hash = _hash(key);
+        bool found;
+        int e = _findOrPrepareInsert(key, hash, found);
+        if (found)
+        {
+            _entryAt(e).kv.second = std::forward<M>(value);
+        }
+        else
+        {
+            e = _constructAt(e, hash, std::forward<K>(key), std::forward<M>(value));
+        }
+        return {iterator(this, e), !found};
+    }
+
+public:
+
+// ================================= CTORS, DTOR & RULE OF 5 =====================================
+
+    /**
+     * Default constructor for hash map.
+     */
+    HashMap() : HashMap(0.25, 0.75)
+    {}
+
+    /**
+     * Constructor of an empty hashmap allocating its memory from the given allocator.
+     * @param allocator allocator
+     */
+    explicit HashMap(const Allocator &allocator)
+            : HashMap(HashMapResizePolicy(), Hash(), KeyEqual(), allocator)
+    {}
+
+    /**
+     * Constructor which receives specific lower and upper load factors;
+     * @param lowerLoadFactor lower load factor
+     * @param upperLoadFactor upper load factor
+     * @param hash hash function object
+     * @param equal equality predicate
+     * @param allocator allocator
+     */
+    HashMap(double lowerLoadFactor, double upperLoadFactor, const Hash &hash = Hash(),
+            const KeyEqual &equal = KeyEqual(), const Allocator &allocator = Allocator())
+            : HashMap(HashMapResizePolicy{lowerLoadFactor, upperLoadFactor}, hash, equal,
+                      allocator)
+    {}
+
+    /**
+     * Constructor which receives a resize policy.
+     * @param policy resize policy
+     * @param hash hash function object
+     * @param equal equality predicate
+     * @param allocator allocator
+     */
+    explicit HashMap(const HashMapResizePolicy &policy, const Hash &hash = Hash(),
+                     const KeyEqual &equal = KeyEqual(), const Allocator &allocator = Allocator())
+            : _size(0), _capacity(0), _deleted(0), _policy(policy), _underloadedErases(0),
+              _segments(), _segmentCount(0), _ctrl(nullptr), _index(nullptr), _rehashStep(0),
+              _oldCtrl(nullptr), _oldIndex(nullptr), _oldCapacity(0), _migrated(0),
+              _insertsSinceReseed(0), _hashFunction(hash), _keyEqual(equal),
+              _allocator(allocator)
+    {
+        if (policy.lowerLoadFactor >= policy.upperLoadFactor || policy.lowerLoadFactor <= 0 ||
+            policy.upperLoadFactor >= 1)
+        {
+            throw std::invalid_argument("Invalid load factors");
+        }
+        if (policy.shrinkHysteresis < 0 || policy.shrinkHysteresis >= 1 ||
+            policy.minCapacity < 1 || policy.shrinkDelay < 0 || policy.maxProbeLength < 0)
+        {
+            throw std::invalid_argument("Invalid resize policy");
+        }
+        _policy.minCapacity = 1;
+        _policy.minCapacity = _capacityFor(0, policy.minCapacity); // rounded up to a power of 2
+        _capacity = _initialCapacity();
+        _segments[0] = _inlineEntries(); // the table is allocated once the inline entries are full
+    }
+
+    /**
+     * Builds a hashmap from 2 vectors of keys and values.
+     * @param keys vector containing keys
+     * @param values vector containing values
+     */
+    HashMap(const std::vector<KeyT> &keys, const std::vector<ValueT> &values)
+            : HashMap(keys.begin(), keys.end(), values.begin(), values.end())
+    {}
+
+    /**
+     * Builds a hashmap from 2 vectors of keys and values, moving the keys and values into the
+     * hashmap instead of copying them.
+     * @param keys vector containing keys
+     * @param values vector containing values
+     */
+    HashMap(std::vector<KeyT> &&keys, std::vector<ValueT> &&values)
+            : HashMap(std::make_move_iterator(keys.begin()), std::make_move_iterator(keys.end()),
+                      std::make_move_iterator(values.begin()),
+                      std::make_move_iterator(values.end()))
+    {}
+
+    /**
+     * Builds a hashmap from 2 ranges of keys and values; the i-th key is mapped to the i-th value,
+     * and a key appearing more than once is mapped to its last value. The table is sized once for
+     * all the keys before inserting them. Any iterators can be used, e.g. pointers into an array,
+     * or std::move_iterator to move the keys and values into the hashmap.
+     * @param keysFirst beginning of the range of keys
+     * @param keysLast end of the range of keys
+     * @param valuesFirst beginning of the range of values
+     * @param valuesLast end of the range of values
+     */
+    template<typename KeyIter, typename ValueIter, _enableIfIterator<KeyIter> = 0,
+            _enableIfIterator<ValueIter> = 0>
+    HashMap(KeyIter keysFirst, KeyIter keysLast, ValueIter valuesFirst, ValueIter valuesLast)
+            : HashMap()
+    {
+        size_t count = _rangeLength(keysFirst, keysLast);
+        if (count != _rangeLength(valuesFirst, valuesLast))
+        {
+            throw std::invalid_argument("Vectors size is not equal");
+        }
+        reserve(count);
+        for (; keysFirst != keysLast && valuesFirst != valuesLast; ++keysFirst, ++valuesFirst)
+        {
+            insert_or_assign(*keysFirst, *valuesFirst); // an existing key gets its value overridden
+        }
+        if (keysFirst != keysLast || valuesFirst != valuesLast)
+        {
+            throw std::invalid_argument("Vectors size is not equal");
+        }
+    }
+
+    /**
+     * Builds a hashmap from a range of pairs of <key,value>; a key appearing more than once is
+     * mapped to its last value. The table is sized once for all the pairs before inserting them.
+     * @param first beginning of the range
+     * @param last end of the range
+     */
+    template<typename PairIter, _enableIfIterator<PairIter> = 0>
+    HashMap(PairIter first, PairIter last) : HashMap()
+    {
+        reserve(_rangeLength(first, last));
+        for (; first != last; ++first)
+        {
+            insert_or_assign((*first).first, (*first).second);
+        }
+    }
+
+    /**
+     * Copy constructor. The entries are copied in order and the index tables byte by byte, so no
+     * key is rehashed; inline entries are copied inline.
+     * @param other other hashmap to copy values from
+     */
+    HashMap(const HashMap &other) : _size(0), _capacity(other._capacity),
+                                    _deleted(other._deleted),
+                                    _policy(other._policy), _underloadedErases(0),
+                                    _segments(), _segmentCount(0),
+                                    _ctrl(nullptr), _index(nullptr),
+                                    _rehashStep(other._rehashStep), _oldCtrl(nullptr),
+                                    _oldIndex(nullptr), _oldCapacity(0), _migrated(0),
+                                    _insertsSinceReseed(other._insertsSinceReseed),
+                                    _hashFunction(other._hashFunction),
+                                    _keyEqual(other._keyEqual),
+                                    _allocator(std::allocator_traits<Allocator>::
+                                               select_on_container_copy_construction(
+                                                       other._allocator))
+    {
+        _segments[0] = _inlineEntries();
+        try
+        {
+            if (other._ctrl != nullptr)
+            {
+                _allocateIndex(_capacity, _ctrl, _index);
+                std::memcpy(_index, other._index, (size_t) _capacity * sizeof(int));
+                std::memcpy(_ctrl, other._ctrl, _ctrlBytes(_capacity));
+            }
+            if (other._oldCtrl != nullptr)
+            {
+                _allocateIndex(other._oldCapacity, _oldCtrl, _oldIndex);
+                std::memcpy(_oldIndex, other._oldIndex, (size_t) other._oldCapacity * sizeof(int));
+                std::memcpy(_oldCtrl, other._oldCtrl, _ctrlBytes(other._oldCapacity));
+                _oldCapacity = other._oldCapacity;
+                _migrated = other._migrated;
+            }
+            for (; _size < other._size; ++_size)
+            {
+                _reserveEntry();
+                new(&_entryAt(_size)) entry(other._entryAt(_size));
+            }
+        }
+        catch (...)
+        {
+            _freeTables();
+            throw;
+        }
+    }
+
+    /**
+     * Copy assignment operator.
+     * @param other other hashmap to assign values from.
+     */
+    HashMap &operator=(const HashMap &other)
+    {
+        if (this != &other)
+        {
+            HashMap temp(other);
+            swap(temp);
+        }
+        return *this;
+    }
+
+    /**
+     * Move constuctor. Takes over the entries and tables of other, which is left as an empty
+     * hashmap; inline entries are moved one by one.
+     * @param other other hashmap to move values from
+     */
+    HashMap(HashMap &&other) noexcept : _size(0), _capacity(0), _deleted(0),
+                                        _policy(other._policy), _underloadedErases(0),
+                                        _segments(), _segmentCount(0),
+                                        _ctrl(nullptr), _index(nullptr),
+                                        _rehashStep(other._rehashStep), _oldCtrl(nullptr),
+                                        _oldIndex(nullptr), _oldCapacity(0), _migrated(0),
+                                        _insertsSinceReseed(0),
+                                        _hashFunction(other._hashFunction),
+                                        _keyEqual(other._keyEqual),
+                                        _allocator(other._allocator)
+    {
+        _segments[0] = _inlineEntries();
+        _capacity = _initialCapacity();
+        swap(other);
+    }
+
+    /**
+     * Move assignment operator.
+     * @param other other hashmap to assign values from
+     */
+    HashMap &operator=(HashMap &&other) noexcept
+    {
+        if (this != &other)
+        {
+            HashMap temp(std::move(other));
+            swap(temp);
+        }
+        return *this;
+    }
+
+    /**
+     * Destructor.
+     */
+    ~HashMap() noexcept
+    {
+        _freeTables();
+    }
+
+    /**
+     * Swaps the contents of two hashmaps. The tables and segments are swapped as pointers, but
+     * inline entries have to move into the inline storage of the other hashmap.
+     * @param other other hashmap
+     */
+    void swap(HashMap &other) noexcept
+    {
+        if (this == &other)
+        {
+            return;
+        }
+        entry *mine = _inlineEntries();
+        entry *theirs = other._inlineEntries();
+        int common = 0;
+        if (_ctrl == nullptr && other._ctrl == nullptr)
+        {
+            for (; common < std::min(_size, other._size); ++common)
+            {
+                entry temp(std::move(mine[common]));
+                mine[common].~entry();
+                _relocate(theirs[common], mine + common);
+                new(theirs + common) entry(std::move(temp));
+            }
+        }
+        for (int e = common; _ctrl == nullptr && e < _size; ++e)
+        {
+            _relocate(mine[e], theirs + e);
+        }
+        for (int e = common; other._ctrl == nullptr && e < other._size; ++e)
+        {
+            _relocate(theirs[e], mine + e);
+        }
+        std::swap(_size, other._size);
+        std::swap(_capacity, other._capacity);
+        std::swap(_deleted, other._deleted);
+        std::swap(_policy, other._policy);
+        std::swap(_underloadedErases, other._underloadedErases);
+        std::swap(_segments, other._segments);
+        std::swap(_segmentCount, other._segmentCount);
+        std::swap(_ctrl, other._ctrl);
+        std::swap(_index, other._index);
+        std::swap(_rehashStep, other._rehashStep);
+        std::swap(_oldCtrl, other._oldCtrl);
+        std::swap(_oldIndex, other._oldIndex);
+        std::swap(_oldCapacity, other._oldCapacity);
+        std::swap(_migrated, other._migrated);
+        std::swap(_insertsSinceReseed, other._insertsSinceReseed);
+        std::swap(_hashFunction, other._hashFunction);
+        std::swap(_keyEqual, other._keyEqual);
+        std::swap(_allocator, other._allocator);
+#ifdef HASHMAP_ENABLE_STATS
+        _Counters::swap(_counters.hits, other._counters.hits);
+        _Counters::swap(_counters.misses, other._counters.misses);
+        _Counters::swap(_counters.hitProbeGroups, other._counters.hitProbeGroups);
+        _Counters::swap(_counters.missProbeGroups, other._counters.missProbeGroups);
+        _Counters::swap(_counters.maxHitProbeLength, other._counters.maxHitProbeLength);
+        _Counters::swap(_counters.maxMissProbeLength, other._counters.maxMissProbeLength);
+        _Counters::swap(_counters.resizes, other._counters.resizes);
+        _Counters::swap(_counters.rebuilds, other._counters.rebuilds);
+        _Counters::swap(_counters.reseeds, other._counters.reseeds);
+        _Counters::swap(_counters.rehashNanoseconds, other._counters.rehashNanoseconds);
+#endif
+        if (_ctrl == nullptr)
+        {
+            _segments[0] = mine;
+        }
+        if (other._ctrl == nullptr)
+        {
+            other._segments[0] = theirs;
+        }
+    }
+
+// ======================================= API METHODS ===========================================
+
+
+    /**
+     * @return the hash function object of the hashmap.
+     */
+    Hash hash_function() const
+    { return _hashFunction; }
+
+    /**
+     * @return the equality predicate of keys of the hashmap.
+     */
+    KeyEqual key_eq() const
+    { return _keyEqual; }
+
+    /**
+     * @return the allocator of the hashmap.
+     */
+    Allocator get_allocator() const
+    { return _allocator; }
+
+    /**
+     * @return size of hashmap, i.e. number of elements.
+     */
+    int size() const
+    { return _size; }
+
+    /**
+     * @return capacity of hashmap.
+     */
+    int capacity() const
+    { return _capacity; }
+
+    /**
+     * @return resize policy of hashmap.
+     */
+    const HashMapResizePolicy &resizePolicy() const
+    { return _policy; }
+
+    /**
+     * @return current load factor of hashmap.
+     */
+    double getLoadFactor() const
+    { return ((double) _size / (double) _capacity); }
+
+    /**
+     * @return true if hash map is empty; false otherwise.
+     */
+    bool empty() const
+    {
+        return (_size == 0);
+    }
+
+
+    /**
+     * Insert a pair of <key,value> to the hashmap.
+     * If a pair with such key already exists, does not perform insertion and returns false;
+     * else, check if resizing is needed, and insert the pair.
+     * @param key key of pair
+     * @param value value of pair
+     * @return true is insertion was performed; false otherwise.
+     */
+    bool insert(const KeyT &key, const ValueT &value)
+    {
+        return _tryEmplace(key, value).second;
+    }
+
+    /**
+     * Insert a pair of <key,value> to the hashmap, moving key and value into it.
+     * If a pair with such key already exists, does not perform insertion and returns false;
+     * else, check if resizing is needed, and insert the pair.
+     * @param key key of pair
+     * @param value value of pair
+     * @return true is insertion was performed; false otherwise.
+     */
+    bool insert(KeyT &&key, ValueT &&value)
+    {
+        return _tryEmplace(std::move(key), std::move(value)).second;
+    }
+
+    /**
+     * Insert a pair to the hashmap if its key does not exist.
+     * @param p pair of <key,value>
+     * @return iterator to the pair of the key, and true if insertion was performed.
+     */
+    std::pair<iterator, bool> insert(const pair &p)
+    {
+        return _tryEmplace(p.first, p.second);
+    }
+
+    /**
+     * Insert a pair to the hashmap if its key does not exist, moving its key and value into it.
+     * @param p pair of <key,value>
+     * @return iterator to the pair of the key, and true if insertion was performed.
+     */
+    std::pair<iterator, bool> insert(pair &&p)
+    {
+        return _tryEmplace(std::move(p.first), std::move(p.second));
+    }
+
+    /**
+     * Constructs a pair of <key,value> from args and inserts it if its key does not exist.
+     * @param args arguments for the constructor of the pair
+     * @return iterator to the pair of the key, and true if insertion was performed.
+     */
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args &&... args)
+    {
+        pair p(std::forward<Args>(args)...);
+        return _tryEmplace(std::move(p.first), std::move(p.second));
+    }
+
+    /**
+     * Inserts a pair of <key,value> constructed in place from args if key does not exist;
+     * otherwise, does nothing (and args are not consumed).
+     * @param key key of pair
+     * @param args arguments for the constructor of the value
+     * @return iterator to the pair of key, and true if insertion was performed.
+     */
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const KeyT &key, Args &&... args)
+    {
+        return _tryEmplace(key, std::forward<Args>(args)...);
+    }
+
+    /**
+     * Inserts a pair of <key,value> constructed in place from args if key does not exist;
+     * otherwise, does nothing (and neither key nor args are consumed).
+     * @param key key of pair, moved into the hashmap if inserted
+     * @param args arguments for the constructor of the value
+     * @return iterator to the pair of key, and true if insertion was performed.
+     */
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(KeyT &&key, Args &&... args)
+    {
+        return _tryEmplace(std::move(key), std::forward<Args>(args)...);
+    }
+
+    /**
+     * Assigns value to key if key exists; otherwise, inserts a pair of <key,value>.
+     * @param key key of pair
+     * @param value value to assign or insert
+     * @return iterator to the pair of key, and true if insertion was performed.
+     */
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(const KeyT &key, M &&value)
+    {
+        return _insertOrAssign(key, std::forward<M>(value));
+    }
+
+    /**
+     * Assigns value to key if key exists; otherwise, inserts a pair of <key,value>.
+     * @param key key of pair, moved into the hashmap if inserted
+     * @param value value to assign or insert
+     * @return iterator to the pair of key, and true if insertion was performed.
+     */
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(KeyT &&key, M &&value)
+    {
+        return _insertOrAssign(std::move(key), std::forward<M>(value));
+    }
+
+    /**
+     * @param key key of type KeyT
+     * @return iterator to the pair of key if key exists; end() otherwise.
+     */
+    iterator find(const KeyT &key)
+    {
+        int e = _findEntry(key, _hash(key));
+        return e == -1 ? end() : iterator(this, e);
+    }
+
+    /**
+     * @param key key of a type comparable with KeyT, e.g. std::string_view for std::string keys
+     * @return iterator to the pair of key if key exists; end() otherwise.
+     */
+    template<typename K, _enableIfTransparent<K> = 0>
+    iterator find(const K &key)
+    {
+        int e = _findEntry(key, _hash(key));
+        return e == -1 ? end() : iterator(this, e);
+    }
+
+    /**
+     * @param key key of type KeyT
+     * @return const iterator to the pair of key if key exists; end() otherwise.
+     */
+    const_iterator find(const KeyT &key) const
+    {
+        int e = _findEntry(key, _hash(key));
+        return e == -1 ? end() : const_iterator(this, e);
+    }
+
+    /**
+     * @param key key of a type comparable with KeyT, e.g. std::string_view for std::string keys
+     * @return const iterator to the pair of key if key exists; end() otherwise.
+     */
+    template<typename K, _enableIfTransparent<K> = 0>
+    const_iterator find(const K &key) const
     {
-        for (pair &p: _bucketsArray[_hash(key)])
-        {
-            if (p.first == key)
-            {
-                return p.second;
-            }
-        }
+        int e = _findEntry(key, _hash(key));
+        return e == -1 ? end() : const_iterator(this, e);
     }
 
-public:
-
-// ================================= CTORS, DTOR & RULE OF 5 =====================================
-
     /**
-     * Default constructor for hash map.
+     * @param key key of KeyT
+     * @return true if key exists in hashmap.
      */
-    HashMap() : HashMap(0.25, 0.75)
-    {}
+    bool containsKey(const KeyT &key) const
+    {
+        return _findEntry(key, _hash(key)) != -1;
+    }
 
     /**
-     * Constructor which receives specific lower and upper load factors;
-     * @param lowerLoadFactor lower load factor
-     * @param upperLoadFactor upper load factor
+     * @param key key of a type comparable with KeyT, e.g. std::string_view for std::string keys
+     * @return true if key exists in hashmap.
      */
-    HashMap(double lowerLoadFactor, double upperLoadFactor) : _size(0), _capacity(16),
-                                                              _upperLoadFactor(upperLoadFactor),
-                                                              _lowerLoadFactor(lowerLoadFactor),
-                                                              _bucketsArray(new bucket[16])
+    template<typename K, _enableIfTransparent<K> = 0>
+    bool containsKey(const K &key) const
     {
-        if (lowerLoadFactor >= upperLoadFactor || lowerLoadFactor <= 0 || upperLoadFactor >= 1)
-        {
-            delete[] _bucketsArray;
-            throw std::invalid_argument("Invalid load factors");
-        }
+        return _findEntry(key, _hash(key)) != -1;
     }
 
     /**
-     * Builds a hashmap from 2 vectors of keys and values.
-     * @param keys vector containing keys
-     * @param values vector containing values
+     * Looks a batch of keys up at once, overlapping their memory accesses; on a table larger than
+     * the cache, this is faster than a loop of find calls, e.g. for scoring a message against many
+     * n-grams.
+     * @param keys array of count keys
+     * @param count number of keys
+     * @param values output - array of count pointers; the i-th is set to the value of the i-th key
+     * if it exists, and to nullptr otherwise
+     * @return number of keys found.
      */
-    HashMap(std::vector<KeyT> keys, std::vector<ValueT> values) : HashMap(0.25, 0.75)
+    int find_batch(const KeyT *keys, size_t count, ValueT **values)
     {
-        if (keys.size() != values.size())
-        {
-            throw std::invalid_argument("Vectors size is not equal");
-        }
-        HashMap(); // create with default values
-        for (size_t i = 0; i < keys.size(); ++i)
-        {
-            bucket &b = _bucketsArray[_hash(keys[i])];
-            for (pair &p: b)
-            {
-                if (p.first == keys[i])
-                {
-                    p.second = values[i];
-                }
-            }
-            // else, new key, do not override
-            insert(keys[i], values[i]);
-        }
+        return _findBatch(keys, count, values);
     }
 
     /**
-     * Copy constructor.
-     * @param other other hashmap to copy values from
+     * Looks a batch of keys up at once, overlapping their memory accesses.
+     * @param keys array of count keys of a type comparable with KeyT, e.g. std::string_view for
+     * std::string keys
+     * @param count number of keys
+     * @param values output - array of count pointers; the i-th is set to the value of the i-th key
+     * if it exists, and to nullptr otherwise
+     * @return number of keys found.
      */
-    HashMap(const HashMap &other) : _size(0), _capacity(other._capacity),
-                                    _lowerLoadFactor(other._lowerLoadFactor),
-                                    _upperLoadFactor(other._upperLoadFactor),
-                                    _bucketsArray(new bucket[other._capacity])
+    template<typename K, _enableIfTransparent<K> = 0>
+    int find_batch(const K *keys, size_t count, ValueT **values)
     {
-        // size incremented during insert operations
-        for (auto pair : other)
-        {
-            this->insert(pair.first, pair.second);
-        }
-    };
+        return _findBatch(keys, count, values);
+    }
 
     /**
-     * Copy assignment operator.
-     * @param other other hashmap to assign values from.
+     * Looks a batch of keys up at once, overlapping their memory accesses.
+     * @param keys array of count keys
+     * @param count number of keys
+     * @param values output - array of count pointers; the i-th is set to the value of the i-th key
+     * if it exists, and to nullptr otherwise
+     * @return number of keys found.
      */
-    HashMap &operator=(const HashMap &other)
+    int find_batch(const KeyT *keys, size_t count, const ValueT **values) const
     {
-        if (this != &other)
-        {
-            if (_capacity != other._capacity)
-            {
-                delete[] _bucketsArray;
-                _bucketsArray = new bucket[other._capacity];
-            }
-            else
-            {
-                this->clear();
-            }
-            _capacity = other._capacity;
-            _lowerLoadFactor = other._lowerLoadFactor;
-            _upperLoadFactor = other._upperLoadFactor;
-            for (auto pair : other)
-            {
-                this->insert(pair.first, pair.second);
-            }
-        }
-        return *this;
+        return _findBatch(keys, count, values);
     }
 
     /**
-     * Move constuctor.
-     * @param other other hashmap to move values from
+     * Looks a batch of keys up at once, overlapping their memory accesses.
+     * @param keys array of count keys of a type comparable with KeyT, e.g. std::string_view for
+     * std::string keys
+     * @param count number of keys
+     * @param values output - array of count pointers; the i-th is set to the value of the i-th key
+     * if it exists, and to nullptr otherwise
+     * @return number of keys found.
      */
-    HashMap(HashMap &&other) noexcept : _size(0), _capacity(other._capacity),
-                                        _lowerLoadFactor(other._lowerLoadFactor),
-                                        _upperLoadFactor(other._upperLoadFactor),
-                                        _bucketsArray(new bucket[other._capacity])
+    template<typename K, _enableIfTransparent<K> = 0>
+    int find_batch(const K *keys, size_t count, const ValueT **values) const
     {
-        // size incremented during insert operations
-        for (auto pair : other)
-        {
-            this->insert(pair.first, pair.second);
-        }
-        delete[] other._bucketsArray;
-        other._bucketsArray = nullptr;
+        return _findBatch(keys, count, values);
     }
 
     /**
-     * Move assignment operator.
-     * @param other other hashmap to assign values from
+     * @param key key of type KeyT
+     * @return returns reference to value of the key if key exists; throws std::out_of_range
+     * otherwise.
      */
-    HashMap &operator=(HashMap &&other) noexcept
+    ValueT &at(const KeyT &key)
     {
-        if (this != &other)
-        {
-            if (_capacity != other._capacity)
-            {
-                delete[] _bucketsArray;
-                _bucketsArray = new bucket[other._capacity];
-            }
-            else
-            {
-                this->clear();
-            }
-            _capacity = other._capacity;
-            _lowerLoadFactor = other._lowerLoadFactor;
-            _upperLoadFactor = other._upperLoadFactor;
-            for (auto pair : other)
-            {
-                this->insert(pair.first, pair.second);
-            }
-            delete[] other._bucketsArray;
-            other._bucketsArray = nullptr;
-        }
-        return *this;
+        return _entryAt(_existingEntry(key)).kv.second;
     }
 
     /**
-     * Destructor.
+     * @param key key of a type comparable with KeyT, e.g. std::string_view for std::string keys
+     * @return returns reference to value of the key if key exists; throws std::out_of_range
+     * otherwise.
      */
-    ~HashMap() noexcept
+    template<typename K, _enableIfTransparent<K> = 0>
+    ValueT &at(const K &key)
     {
-        delete[] _bucketsArray;
+        return _entryAt(_existingEntry(key)).kv.second;
     }
 
-// ======================================= API METHODS ===========================================
-
+    /**
+    * @param key key of type KeyT
+    * @return returns const reference to value of the key if key exists; throws std::out_of_range
+    * otherwise.
+    */
+    const ValueT &at(const KeyT &key) const
+    {
+        return _entryAt(_existingEntry(key)).kv.second;
+    }
 
     /**
-     * @return size of hashmap, i.e. number of elements.
-     */
-    int size() const
-    { return _size; }
+    * @param key key of a type comparable with KeyT, e.g. std::string_view for std::string keys
+    * @return returns const reference to value of the key if key exists; throws std::out_of_range
+    * otherwise.
+    */
+    template<typename K, _enableIfTransparent<K> = 0>
+    const ValueT &at(const K &key) const
+    {
+        return _entryAt(_existingEntry(key)).kv.second;
+    }
 
     /**
-     * @return capacity of hashmap.
+     * Removes a key from hashmap is key exists, and then checks if resizing is neccessary. if key
+     * does not exist, return false;
+     * @param key key of type KeyT
+     * @return true if key was successfully was erased; false otherwise.
      */
-    int capacity() const
-    { return _capacity; }
+    bool erase(const KeyT &key)
+    {
+        return _erase(key, _hash(key));
+    }
 
     /**
-     * @return current load factor of hashmap.
+     * Removes a key from hashmap is key exists, and then checks if resizing is neccessary. if key
+     * does not exist, return false;
+     * @param key key of a type comparable with KeyT, e.g. std::string_view for std::string keys
+     * @return true if key was successfully was erased; false otherwise.
      */
-    double getLoadFactor() const
-    { return ((double) _size / (double) _capacity); }
+    template<typename K, _enableIfTransparent<K> = 0>
+    bool erase(const K &key)
+    {
+        return _erase(key, _hash(key));
+    }
 
     /**
-     * @return true if hash map is empty; false otherwise.
+     * In an open addressing table, the bucket of a key is the group of elements sharing its home
+     * slot; they all lie in the run of non-empty slots starting at that home slot.
+     * @param key key of type KeyT
+     * @return size of bucket which key exists in if key is in hashmap; throws std::out_of_range
+     * if key does not exist in hashmap.
      */
-    bool empty() const
+    int bucketSize(const KeyT &key) const
     {
-        return (_size == 0);
+        size_t hash = _hash(key);
+        if (_ctrl == nullptr) // inline entries: those sharing the home slot of key
+        {
+            if (_scanInline(key, hash) == -1)
+            {
+                throw std::out_of_range("Invalid key");
+            }
+            int count = 0;
+            for (int e = 0; e < _size; ++e)
+            {
+                count += _home(_segments[0][e].hash) == _home(hash);
+            }
+            return count;
+        }
+        const ctrl_t *ctrl = _ctrl;
+        const int *index = _index;
+        int mask = _capacity - 1;
+        if (_findIndex(key, hash) == -1)
+        {
+            if (_probe(_oldCtrl, _oldIndex, _oldCapacity, key, hash) == -1)
+            {
+                throw std::out_of_range("Invalid key");
+            }
+            ctrl = _oldCtrl; // key was not migrated yet
+            index = _oldIndex;
+            mask = _oldCapacity - 1;
+        }
+        int home = (int) (hash & (size_t) mask);
+        int count = 0;
+        for (int i = home; ctrl[i] != EMPTY; i = (i + 1) & mask)
+        {
+            if (_isFull(ctrl[i]) && (int) (_entryAt(index[i]).hash & (size_t) mask) == home)
+            {
+                ++count;
+            }
+        }
+        return count;
     }
 
-
     /**
-     * Insert a pair of <key,value> to the hashmap.
-     * If a pair with such key already exists, does not perform insertion and returns false;
-     * else, check if resizing is needed, and insert the pair.
-     * @param key key of pair
-     * @param value value of pair
-     * @return true is insertion was performed; false otherwise.
+     * clear the hashmap from all the elements.
      */
-    bool insert(KeyT key, ValueT value)
+    void clear()
     {
-        if (containsKey(key))
+        for (int e = 0; e < _size; ++e) // clear every entry
         {
-            return false;
+            _entryAt(e).~entry();
         }
-        if (_checkUpperLoadFactor())
+        if (_ctrl != nullptr)
         {
-            _rehashManager(1);
+            std::memset(_ctrl, EMPTY, _ctrlBytes(_capacity));
         }
-        _bucketsArray[_hash(key)].push_back(pair(key, value));
-        _size++;
-        return true;
+        _freeIndex(_oldIndex, _oldCapacity);
+        _oldCtrl = nullptr;
+        _oldIndex = nullptr;
+        _oldCapacity = 0;
+        _migrated = 0;
+        _size = 0;
+        _deleted = 0;
     }
 
     /**
-     * @param key key of KeyT
-     * @return true if key exists in hashmap.
+     * Makes room for at least count elements, so that inserting them does not resize the table.
+     * @param count number of elements
      */
-    bool containsKey(KeyT key) const
+    void reserve(size_t count)
     {
-        for (pair &p: _bucketsArray[_hash(key)])
+        int capacity = std::max(_capacityFor(count), _capacity);
+        if (_ctrl == nullptr && count > (size_t) INLINE_CAPACITY)
         {
-            if (p.first == key)
-            {
-                return true;
-            }
+            _leaveInline(capacity);
+        }
+        else if (capacity > _capacity)
+        {
+            _rehashTo(capacity);
         }
-        return false;
     }
 
     /**
-     * @param key key of type KeyT
-     * @return returns reference to value of the key if key exists; throws std::out_of_range
-     * otherwise.
+     * Rehashes the table into a table of at least the given number of slots, or more if the
+     * elements would exceed the upper load factor otherwise.
+     * @param buckets minimal number of slots
      */
-    ValueT &at(const KeyT &key)
+    void rehash(size_t buckets)
     {
+        _rehashTo(_capacityFor((size_t) _size, buckets));
+    }
 
-        if (_bucketsArray != nullptr && containsKey(key))
+    /**
+     * Shrinks the table to the smallest capacity holding its elements within the upper load
+     * factor.
+     */
+    void shrink_to_fit()
+    {
+        int capacity = _capacityFor((size_t) _size);
+        if (capacity < _capacity)
         {
-            return _findCell(key);
+            _rehashTo(capacity);
         }
-        throw std::out_of_range("Invalid key");
+        _trimSegments(_size);
     }
 
     /**
-    * @param key key of type KeyT
-    * @return returns const reference to value of the key if key exists; throws std::out_of_range
-    * otherwise.
-    */
-    const ValueT &at(const KeyT &key) const
+     * Sets the rehash mode of the hashmap. By default (step 0), resizing the table rehashes all of
+     * its elements at once. With a positive step, a resize only allocates the new table, and every
+     * following insert or erase migrates the given number of slots of the old table, so the cost
+     * of a resize is spread over many operations; lookups meanwhile search both tables.
+     * @param slotsPerOperation number of old slots migrated per insert/erase, 0 to rehash at once
+     */
+    void setRehashStep(int slotsPerOperation)
     {
-        if (_bucketsArray != nullptr && containsKey(key))
+        if (slotsPerOperation < 0)
+        {
+            throw std::invalid_argument("Invalid rehash step");
+        }
+        _rehashStep = slotsPerOperation;
+        if (_rehashStep == 0)
         {
-            return _findCell(key);
+            _migrate(_oldCapacity);
         }
-        throw std::out_of_range("Invalid key");
     }
 
+#ifdef HASHMAP_ENABLE_STATS
+
     /**
-     * Removes a key from hashmap is key exists, and then checks if resizing is neccessary. if key
-     * does not exist, return false;
-     * @param key key of type KeyT
-     * @return true if key was successfully was erased; false otherwise.
+     * Collects the statistics of the hashmap (see HashMapStats); only available if
+     * HASHMAP_ENABLE_STATS is defined. The probe lengths are measured by walking the table, in
+     * O(capacity); inline entries are all found by a single scan, i.e. a probe length of 1.
+     * @return statistics of the hashmap.
      */
-    bool erase(KeyT key)
+    HashMapStats stats() const
     {
-        if (!containsKey(key))
+        HashMapStats stats;
+        stats.groupWidth = GROUP_WIDTH;
+        auto count = [&stats](int length)
         {
-            return false;
-        }
-        for (auto it = _bucketsArray[_hash(key)].begin();
-             it != _bucketsArray[_hash(key)].end(); ++it)
+            ++stats.probeLengths[std::min(length, HashMapStats::HISTOGRAM_SIZE) - 1];
+            stats.maxProbeLength = std::max(stats.maxProbeLength, length);
+        };
+        auto walk = [this, &count](const ctrl_t *ctrl, const int *index, int capacity)
         {
-            if (it->first == key)
+            int mask = capacity - 1;
+            for (int i = 0; ctrl != nullptr && i < capacity; ++i)
             {
-                _bucketsArray[_hash(key)].erase(it);
-                --_size;
-                break; //break after iterator is no longer valid,we only have one appearance of key
+                if (_isFull(ctrl[i]))
+                {
+                    int home = (int) (_entryAt(index[i]).hash & (size_t) mask);
+                    count(((i - _groupOf(home)) & mask) / GROUP_WIDTH + 1);
+                }
             }
-        }
-        if (_checkLowerLoadFactor())
+        };
+        if (_ctrl == nullptr)
         {
-            _rehashManager(-1);
+            for (int e = 0; e < _size; ++e)
+            {
+                count(1);
+            }
         }
+        walk(_ctrl, _index, _capacity);
+        walk(_oldCtrl, _oldIndex, _oldCapacity); // slots not migrated yet
+        stats.hits = _counters.hits.load(std::memory_order_relaxed);
+        stats.misses = _counters.misses.load(std::memory_order_relaxed);
+        stats.hitProbeGroups = _counters.hitProbeGroups.load(std::memory_order_relaxed);
+        stats.missProbeGroups = _counters.missProbeGroups.load(std::memory_order_relaxed);
+        stats.maxHitProbeLength = (int) _counters.maxHitProbeLength.load(std::memory_order_relaxed);
+        stats.maxMissProbeLength = (int) _counters.maxMissProbeLength.load(
+                std::memory_order_relaxed);
+        stats.resizes = _counters.resizes.load(std::memory_order_relaxed);
+        stats.rebuilds = _counters.rebuilds.load(std::memory_order_relaxed);
+        stats.reseeds = _counters.reseeds.load(std::memory_order_relaxed);
+        stats.rehashNanoseconds = _counters.rehashNanoseconds.load(std::memory_order_relaxed);
+        return stats;
     }
 
     /**
-     * @param key key of type KeyT
-     * @return size of bucket which key exists in if key is in hashmap; throws std::out_of_range
-     * if key does not exist in hashmap.
+     * Zeroes the counters of the statistics, e.g. to sample them periodically; only available if
+     * HASHMAP_ENABLE_STATS is defined.
      */
-    int bucketSize(KeyT key) const
+    void resetStats()
     {
-        if (containsKey(key))
-        {
-            return _bucketsArray[_hash(key)].size();
-        }
-        throw std::out_of_range("Invalid key");
+        _counters.hits.store(0, std::memory_order_relaxed);
+        _counters.misses.store(0, std::memory_order_relaxed);
+        _counters.hitProbeGroups.store(0, std::memory_order_relaxed);
+        _counters.missProbeGroups.store(0, std::memory_order_relaxed);
+        _counters.maxHitProbeLength.store(0, std::memory_order_relaxed);
+        _counters.maxMissProbeLength.store(0, std::memory_order_relaxed);
+        _counters.resizes.store(0, std::memory_order_relaxed);
+        _counters.rebuilds.store(0, std::memory_order_relaxed);
+        _counters.reseeds.store(0, std::memory_order_relaxed);
+        _counters.rehashNanoseconds.store(0, std::memory_order_relaxed);
     }
 
+#endif
+
     /**
-     * clear the hashmap from all the elements.
+     * Builds an immutable, read-optimized copy of the hashmap; see FrozenHashMap.hpp, which must be
+     * included to call it.
+     * @return frozen copy of hashmap.
      */
-    void clear()
+    FrozenHashMap<KeyT, ValueT, Hash, KeyEqual> freeze() const
     {
-        for (int i = 0; i < _capacity; ++i) // clear every cell
-        {
-            _bucketsArray[i].clear();
-        }
-        _size = 0;
+        return FrozenHashMap<KeyT, ValueT, Hash, KeyEqual>(*this);
+    }
+
+    /**
+     * Writes the hashmap to a table file which MappedHashMap maps and queries in place, without
+     * loading it; see MappedHashMap.hpp, which must be included to call it.
+     * @param path path of the table file, replaced if it exists
+     */
+    void serialize(const std::string &path) const
+    {
+        MappedHashMap<KeyT, ValueT>::write(*this, path);
     }
 
 // ================================= OPERATORS OVERLOADING =======================================
@@ -434,16 +2478,14 @@ public:
     bool operator==(const HashMap &other) const
     {
         if (_size != other._size || _capacity != other._capacity ||
-            _lowerLoadFactor != other._lowerLoadFactor ||
-            _upperLoadFactor != other._upperLoadFactor) // check equality of data members
+            !(_policy == other._policy)) // check equality of data members
         {
             return false;
         }
-        for (int i = 0; i < _capacity; ++i) // check both maps key->value pairs are identical
+        for (const pair &p : *this) // check both maps key->value pairs are identical
         {
-            std::sort(_bucketsArray[i].begin(), _bucketsArray[i].end());
-            std::sort(other._bucketsArray[i].begin(), other._bucketsArray[i].end());
-            if (_bucketsArray[i] != other._bucketsArray[i]) // use built-in vector comparison
+            int e = other._findEntry(p.first, other._hash(p.first));
+            if (e == -1 || !(other._entryAt(e).kv.second == p.second))
             {
                 return false;
             }
@@ -467,120 +2509,103 @@ public:
      * @return reference to the value of key if key exists; else create a default ValueT and
      * returns a reference to it.
      */
-    ValueT &operator[](const KeyT &key) noexcept
+    ValueT &operator[](const KeyT &key)
     {
-        if (containsKey(key))
-        {
-            return _findCell(key);
-        }
-        else
-        {
-            ValueT defaultVal = ValueT();
-            insert(key, defaultVal);
-            return _findCell(key);
-        }
+        return _tryEmplace(key).first->second;
     }
 
     /**
-    * [] operator overloading.
+     * [] operator overloading.
+     * @param key key of type KeyT, moved into the hashmap if inserted
+     * @return reference to the value of key if key exists; else create a default ValueT and
+     * returns a reference to it.
+     */
+    ValueT &operator[](KeyT &&key)
+    {
+        return _tryEmplace(std::move(key)).first->second;
+    }
+
+    /**
+    * [] operator overloading. A const hashmap can not insert the key, so like at(), a missing key
+    * throws.
     * @param key key of type KeyT
-    * @return reference to the value of key if key exists; else, behaviour is undefined.
+    * @return reference to the value of key if key exists; throws std::out_of_range otherwise.
     */
-    const ValueT &operator[](const KeyT &key) const noexcept
+    const ValueT &operator[](const KeyT &key) const
     {
-        if (containsKey(key))
-        {
-            return _findCell(key);
-        }
+        return _entryAt(_existingEntry(key)).kv.second;
     }
 
 // ======================================= ITERATOR ==============================================
 
     /**
-     * Iterator for hashmap, allowing to perform for-each loop on hashmaps.
+     * Iterator for hashmap, allowing to perform for-each loop on hashmaps. It walks the dense
+     * entries, so a full iteration costs O(size) whatever the capacity, and begin() is O(1).
+     * Pairs are visited in insertion order, except that erasing a key moves the last pair into
+     * its place.
+     * @tparam IsConst true for an iterator over const pairs
      */
-    class iterator
+    template<bool IsConst>
+    class basicIterator
     {
+        friend class HashMap;
+        using mapT = typename std::conditional<IsConst, const HashMap, HashMap>::type;
+        using pairT = typename std::conditional<IsConst, const pair, pair>::type;
 
     private:
-        const HashMap *_map; // pointer to map
-        int _bucketIdx; // current bucket index
-        bucket *_bucket; // pointer to current bucket
-        bucketIter _cell; // iterator of the cell in current bucket
-
+        mapT *_map; // pointer to map
+        int _entry; // index of current entry, size of the map at end
 
     public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = pair;
+        using difference_type = std::ptrdiff_t;
+        using pointer = pairT *;
+        using reference = pairT &;
+
         /**
          * Constructor for iterator.
          * @param map hashmap pointer
          * @param start bool - if start returns the beginning of hashmap; else value is end, return
          * the end of hashmap.
          */
-        iterator(const HashMap *map, bool start) : _map(map)
+        basicIterator(mapT *map, bool start) : _map(map), _entry(start ? 0 : map->_size)
+        {}
+
+        /**
+         * Constructor for an iterator pointing to a given entry.
+         * @param map hashmap pointer
+         * @param entry index of an entry
+         */
+        basicIterator(mapT *map, int entry) : _map(map), _entry(entry)
+        {}
+
+        /**
+         * Conversion of an iterator to a const iterator.
+         * @return const iterator pointing to the same pair
+         */
+        operator basicIterator<true>() const
         {
-            if (start)
-            {
-                for (int i = 0; i < map->_capacity; ++i)
-                {
-                    if (!map->_bucketsArray[i].empty())
-                    {
-                        _bucketIdx = i;
-                        break;
-                    }
-                }
-                _bucket = _map->_bucketsArray + _bucketIdx;
-                _cell = _bucket->begin();
-            }
-            else
-            {
-                _bucketIdx = map->_capacity - 1;
-                _bucket = _map->_bucketsArray + _bucketIdx;
-                _cell = _bucket->end();
-            }
+            return basicIterator<true>(_map, _entry);
         }
 
         /**
          * Prefix ++ operator.
          * @return this iterator
          */
-        iterator operator++()
+        basicIterator &operator++()
         {
-            ++_cell;
-            if (_cell != _bucket->end())
-            {
-                return *this;
-            }
-            // else, end of current bucket
-            // continue to next bucket while buckets are empty
-            while ((_bucket + 1)->empty())
-            {
-                ++_bucketIdx;
-                ++_bucket;
-            }
-            // check if we are at the last bucket
-            if (_bucketIdx < _map->_capacity - 1)
-            {
-                ++_bucketIdx;
-                ++_bucket;
-                _cell = _bucket->begin();
-                return *this;
-            }
-            else
-            {
-                _cell = _bucket->end();
-            }
+            ++_entry;
             return *this;
-
-
         }
 
         /**
          * Post fix ++ operator.
          * @return this iterator
          */
-        iterator operator++(int)
+        basicIterator operator++(int)
         {
-            iterator temp = *this;
+            basicIterator temp = *this;
             ++(*this);
             return temp;
 
@@ -588,27 +2613,26 @@ public:
 
         /**
          * Dereference operator.
-         * @return const reference to the current pair pointed by _cell
+         * @return reference to the current pair pointed by _entry
          */
-        const pair &operator*() const
-        { return *_cell; }
+        pairT &operator*() const
+        { return _map->_entryAt(_entry).kv; }
 
         /**
         * Arrow operator.
-        * @return reference to the current pair pointed by _cell
+        * @return pointer to the current pair pointed by _entry
         */
-        pair &operator->() const
-        { return &(*_cell); }
+        pairT *operator->() const
+        { return &_map->_entryAt(_entry).kv; }
 
         /**
          * Equality comparison operator.
          * @param rhs other iterator
          * @return true if iterators are identical; false otherwise.
          */
-        bool operator==(const iterator &rhs) const
+        bool operator==(const basicIterator &rhs) const
         {
-            return (_map == rhs._map && _bucketIdx == rhs._bucketIdx &&
-                    _cell == rhs._cell && _bucket == rhs._bucket);
+            return (_map == rhs._map && _entry == rhs._entry);
         }
 
         /**
@@ -616,7 +2640,7 @@ public:
         * @param rhs other iterator
         * @return false if iterators are identical; true otherwise.
         */
-        bool operator!=(const iterator &rhs) const
+        bool operator!=(const basicIterator &rhs) const
         {
             return !(*this == rhs);
         }
@@ -624,7 +2648,21 @@ public:
 
     };
 
-    typedef HashMap<KeyT, ValueT>::iterator const_iterator;
+    /**
+     * @return first pair of hashmap, i.e. the beginning of hashmap.
+     */
+    iterator begin()
+    {
+        return iterator(this, true);
+    }
+
+    /**
+    * @return end of hashmap, pointer to the last pair + 1.
+    */
+    iterator end()
+    {
+        return iterator(this, false);
+    }
 
     /**
      * @return first pair of hashmap, i.e. the beginning of hashmap.
@@ -0,0 +1,504 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "HashMap.hpp"
+
+#define USAGE "Usage: HashMapBenchmark [size] [queries]\n" \
+              "       HashMapBenchmark --suite <csv|json> [max size]"
+#define SUITE_FLAG "--suite"
+#define DEFAULT_SIZE 1000000
+#define DEFAULT_QUERIES 4000000
+#define ROUNDS 5
+#define SUITE_MIN_SIZE 100
+#define SUITE_MAX_SIZE 10000000
+#define SUITE_MAX_QUERIES 1000000 // hit and miss lookups per round
+#define SUITE_TARGET_OPERATIONS 3000000 // operations of all the rounds of a benchmark
+#define SUITE_MIN_ROUNDS 3
+#define SUITE_MAX_ROUNDS 1000
+
+/**
+ * Prevents the compiler from optimizing a benchmarked result away.
+ */
+volatile long sink;
+
+/**
+ * Runs a benchmark ROUNDS times.
+ * @param run function object running the benchmark once, returning a checksum
+ * @param operations number of operations in one run
+ * @return the fastest time of a single operation, in nanoseconds.
+ */
+template<typename F>
+double measure(F run, size_t operations)
+{
+    double best = 0;
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        auto start = std::chrono::steady_clock::now();
+        sink = sink + run();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        double perOperation = elapsed.count() / (double) operations;
+        if (round == 0 || perOperation < best)
+        {
+            best = perOperation;
+        }
+    }
+    return best;
+}
+
+/**
+ * Compares looking queries up one by one (containsKey and at) with find_batch, in a map of the
+ * given keys; about half of the queries are hits.
+ * @param name name of the workload
+ * @param keys keys of the map
+ * @param queries keys to look up
+ */
+template<typename KeyT>
+void compareLookups(const std::string &name, const std::vector<KeyT> &keys,
+                    const std::vector<KeyT> &queries)
+{
+    HashMap<KeyT, int> map;
+    map.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        map.insert(keys[i], (int) i);
+    }
+    double single = measure([&]()
+                            {
+                                long sum = 0;
+                                for (const KeyT &key : queries)
+                                {
+                                    if (map.containsKey(key))
+                                    {
+                                        sum += map.at(key);
+                                    }
+                                }
+                                return sum;
+                            }, queries.size());
+    std::vector<int *> values(queries.size());
+    double batch = measure([&]()
+                           {
+                               long sum = 0;
+                               map.find_batch(queries.data(), queries.size(), values.data());
+                               for (int *value : values)
+                               {
+                                   sum += value == nullptr ? 0 : *value;
+                               }
+                               return sum;
+                           }, queries.size());
+    std::cout << name << ": containsKey/at " << single << " ns/key, find_batch " << batch
+              << " ns/key (x" << single / batch << ")" << std::endl;
+}
+
+/**
+ * Measures lookups which all hit, and lookups which all miss, in a map of the given keys. Built
+ * with HASHMAP_ENABLE_STATS, also reports the mean and longest probe length of each, in groups.
+ * @param name name of the workload
+ * @param keys keys of the map
+ * @param hits keys of the map to look up
+ * @param misses keys absent from the map to look up
+ */
+template<typename KeyT>
+void measureHitsAndMisses(const std::string &name, const std::vector<KeyT> &keys,
+                          const std::vector<KeyT> &hits, const std::vector<KeyT> &misses)
+{
+    HashMap<KeyT, int> map;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        map.insert(keys[i], (int) i);
+    }
+    auto lookups = [&map](const std::vector<KeyT> &queries)
+    {
+        long sum = 0;
+        for (const KeyT &key : queries)
+        {
+            auto it = map.find(key);
+            sum += it == map.end() ? 0 : it->second;
+        }
+        return sum;
+    };
+#ifdef HASHMAP_ENABLE_STATS
+    map.resetStats();
+#endif
+    double hit = measure([&]()
+                         { return lookups(hits); }, hits.size());
+    double miss = measure([&]()
+                          { return lookups(misses); }, misses.size());
+    std::cout << name << " (load factor " << map.getLoadFactor() << "): hit " << hit
+              << " ns/key, miss " << miss << " ns/key" << std::endl;
+#ifdef HASHMAP_ENABLE_STATS
+    HashMapStats stats = map.stats();
+    std::cout << "    probe length in groups of " << stats.groupWidth << ": hit mean "
+              << stats.meanHitProbeLength() << ", max " << stats.maxHitProbeLength
+              << "; miss mean " << stats.meanMissProbeLength() << ", max "
+              << stats.maxMissProbeLength << std::endl;
+#endif
+}
+
+// ==================================== BENCHMARK SUITE ==========================================
+
+/**
+ * Keys of a suite benchmark: the keys of the map, in insertion order, keys of the map to look up,
+ * drawn at random, and keys absent from the map to look up.
+ */
+template<typename KeyT>
+struct Workload
+{
+    std::vector<KeyT> keys;
+    std::vector<KeyT> hits;
+    std::vector<KeyT> misses;
+};
+
+/**
+ * @param i index of a key
+ * @return distinct non negative keys for distinct indices, spread over the whole range of long.
+ */
+long longKey(size_t i)
+{
+    uint64_t mixed = ((uint64_t) i + 1) * 0x9E3779B97F4A7C15ull; // odd factor: a bijection
+    return (long) (mixed & (uint64_t) std::numeric_limits<long>::max());
+}
+
+/**
+ * Builds a workload.
+ * @param size number of keys of the map
+ * @param makeKey function object returning the i-th key of the map as makeKey(i, true), and the
+ * i-th absent key as makeKey(i, false)
+ * @param random random generator
+ * @return workload of size keys.
+ */
+template<typename KeyT, typename F>
+Workload<KeyT> makeWorkload(size_t size, F makeKey, std::mt19937_64 &random)
+{
+    size_t queries = std::min(size, (size_t) SUITE_MAX_QUERIES);
+    Workload<KeyT> workload;
+    workload.keys.reserve(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        workload.keys.push_back(makeKey(i, true));
+    }
+    for (size_t i = 0; i < queries; ++i)
+    {
+        workload.hits.push_back(workload.keys[random() % size]);
+        workload.misses.push_back(makeKey(i, false));
+    }
+    return workload;
+}
+
+/**
+ * Writes the results of the suite as they come, as CSV or as JSON in the style of Google
+ * Benchmark, so that the results of different versions can be compared by scripts.
+ */
+class Report
+{
+    bool _json;
+    bool _first; // no result was written yet
+
+public:
+    /**
+     * Constructor, writes the header of the report.
+     * @param json true for JSON; false for CSV
+     */
+    explicit Report(bool json) : _json(json), _first(true)
+    {
+        std::cout << (_json ? "{\n  \"benchmarks\": [" :
+                      "container,key,size,operation,ns_per_op,rounds") << std::endl;
+    }
+
+    Report(const Report &other) = delete;
+
+    Report &operator=(const Report &other) = delete;
+
+    /**
+     * Destructor, closes the report.
+     */
+    ~Report()
+    {
+        if (_json)
+        {
+            std::cout << "\n  ]\n}" << std::endl;
+        }
+    }
+
+    /**
+     * Writes a result.
+     * @param container name of the container
+     * @param key name of the key type
+     * @param size number of keys of the map
+     * @param operation name of the operation
+     * @param nsPerOperation fastest time of an operation, in nanoseconds
+     * @param rounds number of rounds measured
+     */
+    void add(const std::string &container, const std::string &key, size_t size,
+             const std::string &operation, double nsPerOperation, size_t rounds)
+    {
+        if (!_json)
+        {
+            std::cout << container << "," << key << "," << size << "," << operation << ","
+                      << nsPerOperation << "," << rounds << std::endl;
+            return;
+        }
+        std::cout << (_first ? "\n" : ",\n") << "    {\"name\": \"" << container << "/" << key
+                  << "/" << operation << "/" << size << "\", \"container\": \"" << container
+                  << "\", \"key\": \"" << key << "\", \"size\": " << size
+                  << ", \"operation\": \"" << operation << "\", \"ns_per_op\": " << nsPerOperation
+                  << ", \"rounds\": " << rounds << "}" << std::flush;
+        _first = false;
+    }
+};
+
+/**
+ * @param operations number of operations in one round
+ * @return number of rounds measuring about SUITE_TARGET_OPERATIONS operations in all.
+ */
+size_t roundsFor(size_t operations)
+{
+    return std::max((size_t) SUITE_MIN_ROUNDS,
+                    std::min((size_t) SUITE_MAX_ROUNDS, SUITE_TARGET_OPERATIONS / operations));
+}
+
+/**
+ * Runs a benchmark roundsFor(operations) times, preparing every round untimed.
+ * @param setup function object returning the state of a round, e.g. a map to erase from
+ * @param run function object running the benchmark once on the state, returning a checksum
+ * @param operations number of operations in one round
+ * @return the fastest time of a single operation, in nanoseconds.
+ */
+template<typename Setup, typename F>
+double measureRounds(Setup setup, F run, size_t operations)
+{
+    double best = 0;
+    for (size_t round = 0; round < roundsFor(operations); ++round)
+    {
+        auto state = setup();
+        auto start = std::chrono::steady_clock::now();
+        sink = sink + run(state);
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        double perOperation = elapsed.count() / (double) operations;
+        if (round == 0 || perOperation < best)
+        {
+            best = perOperation;
+        }
+    }
+    return best;
+}
+
+/**
+ * Benchmarks the operations of a map type on a workload: inserting its keys into an empty map,
+ * looking up keys which hit and keys which miss, iterating, copying, and erasing every key.
+ * @param report report of the results
+ * @param container name of the map type
+ * @param key name of the key type
+ * @param workload workload
+ */
+template<typename Map, typename KeyT>
+void benchmarkMap(Report &report, const std::string &container, const std::string &key,
+                  const Workload<KeyT> &workload)
+{
+    const std::vector<KeyT> &keys = workload.keys;
+    size_t size = keys.size();
+    auto empty = []()
+    { return Map(); };
+    auto nothing = []()
+    { return 0; };
+    auto insert = [&keys](Map &map)
+    {
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            map.emplace(keys[i], (int) i);
+        }
+        return (long) map.size();
+    };
+    report.add(container, key, size, "insert", measureRounds(empty, insert, size), roundsFor(size));
+    Map built;
+    insert(built);
+    auto lookups = [&built](const std::vector<KeyT> &queries)
+    {
+        long sum = 0;
+        for (const KeyT &query : queries)
+        {
+            auto it = built.find(query);
+            sum += it == built.end() ? 0 : it->second;
+        }
+        return sum;
+    };
+    size_t queries = workload.hits.size();
+    report.add(container, key, size, "hit", measureRounds(nothing, [&](int)
+    { return lookups(workload.hits); }, queries), roundsFor(queries));
+    report.add(container, key, size, "miss", measureRounds(nothing, [&](int)
+    { return lookups(workload.misses); }, queries), roundsFor(queries));
+    report.add(container, key, size, "iterate", measureRounds(nothing, [&built](int)
+    {
+        long sum = 0;
+        for (const auto &p : built)
+        {
+            sum += p.second;
+        }
+        return sum;
+    }, size), roundsFor(size));
+    report.add(container, key, size, "copy", measureRounds(empty, [&built](Map &map)
+    {
+        map = built;
+        return (long) map.size();
+    }, size), roundsFor(size));
+    auto copyOfBuilt = [&built]()
+    { return built; };
+    auto erase = [&keys](Map &map)
+    {
+        long erased = 0;
+        for (const KeyT &k : keys)
+        {
+            erased += (long) map.erase(k);
+        }
+        return erased;
+    };
+    report.add(container, key, size, "erase", measureRounds(copyOfBuilt, erase, size),
+               roundsFor(size));
+}
+
+/**
+ * Benchmarks HashMap against std::unordered_map on keys of one type, at sizes of 100, 1000, ...
+ * up to maxSize.
+ * @param report report of the results
+ * @param key name of the key type
+ * @param maxSize largest number of keys
+ * @param makeKey function object making keys, see makeWorkload
+ */
+template<typename KeyT, typename F>
+void benchmarkKeys(Report &report, const std::string &key, size_t maxSize, F makeKey)
+{
+    std::mt19937_64 random(2026);
+    for (size_t size = SUITE_MIN_SIZE; size <= maxSize; size *= 10)
+    {
+        Workload<KeyT> workload = makeWorkload<KeyT>(size, makeKey, random);
+        benchmarkMap<HashMap<KeyT, int>>(report, "HashMap", key, workload);
+        benchmarkMap<std::unordered_map<KeyT, int>>(report, "std::unordered_map", key, workload);
+    }
+}
+
+/**
+ * Runs the benchmark suite: every operation of benchmarkMap, on HashMap and std::unordered_map,
+ * with long keys, short strings (stored inline by std::string) and long strings (URL like, 60 to
+ * 70 characters). The largest sizes need several GB of memory.
+ * @param json true for a JSON report; false for CSV
+ * @param maxSize largest number of keys
+ */
+void runSuite(bool json, size_t maxSize)
+{
+    Report report(json);
+    benchmarkKeys<long>(report, "long", maxSize, [](size_t i, bool present)
+    { return present ? longKey(i) : -longKey(i) - 1; });
+    benchmarkKeys<std::string>(report, "short_string", maxSize, [](size_t i, bool present)
+    { return (present ? "k" : "m") + std::to_string(i); });
+    benchmarkKeys<std::string>(report, "long_string", maxSize, [](size_t i, bool present)
+    {
+        return (present ? "/api/v1/users/" : "/api/v2/users/") + std::to_string(i) +
+               "/settings/notifications?locale=en-US&format=json";
+    });
+}
+
+/**
+ * Parses a positive number argument.
+ * @param arg argument
+ * @return the number; throws std::invalid_argument if arg is not a positive number.
+ */
+size_t parseCount(const char *arg)
+{
+    size_t count = std::stoul(arg);
+    if (count == 0)
+    {
+        throw std::invalid_argument(USAGE);
+    }
+    return count;
+}
+
+/**
+ * Benchmarks batched lookups against single lookups, and hit and miss lookups, on long keys and on
+ * n-gram like string keys; or, with --suite, runs the benchmark suite (see runSuite).
+ * @param argc number of arguments
+ * @param argv optional number of keys in the map, and number of lookups; or --suite, the format of
+ * the report, and optionally the largest number of keys
+ * @return EXIT_SUCCESS, or EXIT_FAILURE on invalid arguments.
+ */
+int main(int argc, char *argv[])
+{
+    size_t size = DEFAULT_SIZE;
+    size_t queryCount = DEFAULT_QUERIES;
+    try
+    {
+        if (argc > 1 && std::string(argv[1]) == SUITE_FLAG)
+        {
+            std::string format = argc > 2 ? argv[2] : "";
+            if ((format != "csv" && format != "json") || argc > 4)
+            {
+                throw std::invalid_argument(USAGE);
+            }
+            runSuite(format == "json", argc > 3 ? parseCount(argv[3]) : SUITE_MAX_SIZE);
+            return EXIT_SUCCESS;
+        }
+        if (argc > 3)
+        {
+            throw std::invalid_argument(USAGE);
+        }
+        if (argc > 1)
+        {
+            size = parseCount(argv[1]);
+        }
+        if (argc > 2)
+        {
+            queryCount = parseCount(argv[2]);
+        }
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << USAGE << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::mt19937_64 random(2026);
+    std::vector<long> longKeys(size);
+    std::vector<long> longQueries(queryCount);
+    for (long &key : longKeys)
+    {
+        key = (long) (random() >> 1);
+    }
+    for (long &query : longQueries)
+    {
+        query = random() % 2 == 0 ? longKeys[random() % size] : (long) (random() >> 1);
+    }
+    compareLookups("long keys", longKeys, longQueries);
+    std::vector<long> longHits(queryCount);
+    std::vector<long> longMisses(queryCount);
+    for (size_t i = 0; i < queryCount; ++i)
+    {
+        longHits[i] = longKeys[random() % size];
+        longMisses[i] = -(long) (random() >> 1) - 1; // keys are non negative
+    }
+    measureHitsAndMisses("long keys", longKeys, longHits, longMisses);
+    std::vector<std::string> stringKeys(size);
+    std::vector<std::string> stringQueries(queryCount);
+    for (std::string &key : stringKeys)
+    {
+        key = "phrase " + std::to_string(random() % 100000) + " of " + std::to_string(random());
+    }
+    for (std::string &query : stringQueries)
+    {
+        query = random() % 2 == 0 ? stringKeys[random() % size] :
+                "phrase " + std::to_string(random() % 100000) + " or " + std::to_string(random());
+    }
+    compareLookups("string keys", stringKeys, stringQueries);
+    std::vector<std::string> stringHits(queryCount);
+    std::vector<std::string> stringMisses(queryCount);
+    for (size_t i = 0; i < queryCount; ++i)
+    {
+        stringHits[i] = stringKeys[random() % size];
+        stringMisses[i] = "phrase " + std::to_string(random() % 100000) + " or " +
+                          std::to_string(random());
+    }
+    measureHitsAndMisses("string keys", stringKeys, stringHits, stringMisses);
+    return EXIT_SUCCESS;
+}
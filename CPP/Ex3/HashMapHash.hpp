@@ -0,0 +1,396 @@
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+
+#ifndef EX3_HASHMAPHASH_H
+#define EX3_HASHMAPHASH_H
+
+/**
+ * Non-cryptographic hashing primitives used by the default hash function of HashMap, following
+ * wyhash (final version 4): mixing is done by one 64x64->128 bit multiplication, folding the high
+ * half of the product onto the low half.
+ */
+namespace hashing
+{
+    /**
+     * Secret constants of wyhash.
+     */
+    constexpr uint64_t SECRET[4] = {0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+                                    0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull};
+
+    /**
+     * Multiplies two 64 bit numbers into a 128 bit product.
+     * @param a input - first factor; output - low 64 bits of the product
+     * @param b input - second factor; output - high 64 bits of the product
+     */
+    inline void multiply(uint64_t &a, uint64_t &b)
+    {
+#ifdef __SIZEOF_INT128__
+        __uint128_t r = (__uint128_t) a * b;
+        a = (uint64_t) r;
+        b = (uint64_t) (r >> 64);
+#else
+        uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t) a, lb = (uint32_t) b;
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+        uint64_t t = rl + (rm0 << 32);
+        uint64_t carry = t < rl;
+        uint64_t lo = t + (rm1 << 32);
+        carry += lo < t;
+        uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+        a = lo;
+        b = hi;
+#endif
+    }
+
+    /**
+     * @return the 128 bit product of a and b, folded into 64 bits.
+     */
+    inline uint64_t mix(uint64_t a, uint64_t b)
+    {
+        multiply(a, b);
+        return a ^ b;
+    }
+
+    /**
+     * Finalizer for hashes of poor quality, such as the identity hash libstdc++ uses for integers:
+     * every input bit affects both the low bits (the home slot in HashMap) and the high bits (the
+     * control byte) of the result.
+     * @param x value to mix
+     * @return mixed value
+     */
+    inline uint64_t mix(uint64_t x)
+    {
+        return mix(x ^ SECRET[0], SECRET[1]);
+    }
+
+    /**
+     * @return 8 bytes read from p, in native byte order.
+     */
+    inline uint64_t read8(const unsigned char *p)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        return v;
+    }
+
+    /**
+     * @return 4 bytes read from p, in native byte order.
+     */
+    inline uint64_t read4(const unsigned char *p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+
+    /**
+     * Hashes a sequence of bytes (wyhash).
+     * @param data bytes to hash
+     * @param len number of bytes
+     * @param seed seed of the hash
+     * @return hash of the bytes
+     */
+    inline uint64_t hashBytes(const void *data, size_t len, uint64_t seed = 0)
+    {
+        const unsigned char *p = (const unsigned char *) data;
+        seed ^= mix(seed ^ SECRET[0], SECRET[1]);
+        uint64_t a, b;
+        if (len <= 16)
+        {
+            if (len >= 4)
+            {
+                a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+                b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+            }
+            else if (len > 0)
+            {
+                a = ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+                b = 0;
+            }
+            else
+            {
+                a = b = 0;
+            }
+        }
+        else
+        {
+            size_t i = len;
+            if (i > 48)
+            {
+                uint64_t see1 = seed, see2 = seed;
+                do
+                {
+                    seed = mix(read8(p) ^ SECRET[1], read8(p + 8) ^ seed);
+                    see1 = mix(read8(p + 16) ^ SECRET[2], read8(p + 24) ^ see1);
+                    see2 = mix(read8(p + 32) ^ SECRET[3], read8(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (i > 16)
+            {
+                seed = mix(read8(p) ^ SECRET[1], read8(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+            a = read8(p + i - 16);
+            b = read8(p + i - 8);
+        }
+        a ^= SECRET[1];
+        b ^= seed;
+        multiply(a, b);
+        return mix(a ^ SECRET[0] ^ len, b ^ SECRET[1]);
+    }
+
+    /**
+     * @return x rotated left by r bits, 0 < r < 64.
+     */
+    inline uint64_t rotateLeft(uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    /**
+     * One SipRound of SipHash, on its state v.
+     */
+    inline void sipRound(uint64_t v[4])
+    {
+        v[0] += v[1];
+        v[1] = rotateLeft(v[1], 13) ^ v[0];
+        v[0] = rotateLeft(v[0], 32);
+        v[2] += v[3];
+        v[3] = rotateLeft(v[3], 16) ^ v[2];
+        v[0] += v[3];
+        v[3] = rotateLeft(v[3], 21) ^ v[0];
+        v[2] += v[1];
+        v[1] = rotateLeft(v[1], 17) ^ v[2];
+        v[2] = rotateLeft(v[2], 32);
+    }
+
+    /**
+     * Hashes a sequence of bytes with SipHash, a keyed pseudorandom function: without the key,
+     * inputs colliding in the hash can not be computed, so they can not be sent to a hashmap to
+     * degrade it. Little-endian words are read in native order, so hashes only match the reference
+     * implementation on little-endian machines.
+     * @tparam CompressionRounds SipRounds per 8 bytes of input
+     * @tparam FinalizationRounds SipRounds at the end
+     * @param data bytes to hash
+     * @param len number of bytes
+     * @param k0 first half of the 128 bit key
+     * @param k1 second half of the 128 bit key
+     * @return hash of the bytes
+     */
+    template<int CompressionRounds = 1, int FinalizationRounds = 3>
+    uint64_t sipHash(const void *data, size_t len, uint64_t k0, uint64_t k1)
+    {
+        const unsigned char *p = (const unsigned char *) data;
+        uint64_t v[4] = {k0 ^ 0x736f6d6570736575ull, k1 ^ 0x646f72616e646f6dull,
+                         k0 ^ 0x6c7967656e657261ull, k1 ^ 0x7465646279746573ull};
+        const unsigned char *end = p + (len & ~(size_t) 7);
+        for (; p != end; p += 8)
+        {
+            uint64_t m = read8(p);
+            v[3] ^= m;
+            for (int i = 0; i < CompressionRounds; ++i)
+            {
+                sipRound(v);
+            }
+            v[0] ^= m;
+        }
+        uint64_t last = (uint64_t) len << 56;
+        for (size_t i = 0; i < (len & 7); ++i)
+        {
+            last |= (uint64_t) p[i] << (8 * i);
+        }
+        v[3] ^= last;
+        for (int i = 0; i < CompressionRounds; ++i)
+        {
+            sipRound(v);
+        }
+        v[0] ^= last;
+        v[2] ^= 0xff;
+        for (int i = 0; i < FinalizationRounds; ++i)
+        {
+            sipRound(v);
+        }
+        return v[0] ^ v[1] ^ v[2] ^ v[3];
+    }
+
+    /**
+     * @return 64 random bits from std::random_device, usually a system call.
+     */
+    inline uint64_t deviceSeed()
+    {
+        std::random_device device;
+        return ((uint64_t) device() << 32) ^ device();
+    }
+
+    /**
+     * Draws a random 64 bit seed. The process draws a secret key with deviceSeed once, and every
+     * seed is the SipHash of a counter under that key, so seeds are unpredictable, differ between
+     * calls and threads, and cost no system call after the first one.
+     * @return random seed
+     */
+    inline uint64_t randomSeed()
+    {
+        static const uint64_t key[2] = {deviceSeed(), deviceSeed()};
+        static std::atomic<uint64_t> counter{0};
+        uint64_t count = counter.fetch_add(1, std::memory_order_relaxed);
+        return sipHash(&count, sizeof(count), key[0], key[1]);
+    }
+}
+
+/**
+ * The default hash function of HashMap: std::hash, followed by the hashing::mix finalizer, so that
+ * sequential or stride-aligned integer keys do not crowd into a few slots.
+ * @tparam KeyT type of keys
+ */
+template<typename KeyT>
+struct HashMapHash
+{
+    /**
+     * @param key key to hash
+     * @return hash of key
+     */
+    size_t operator()(const KeyT &key) const
+    {
+        return (size_t) hashing::mix((uint64_t) std::hash<KeyT>()(key));
+    }
+};
+
+/**
+ * The hash function of strings hashes their characters with hashing::hashBytes. It is transparent:
+ * it hashes any string-like argument (std::string, std::string_view, const char *) as a
+ * std::string_view, which lets HashMap<std::string, ValueT> look keys up without building a
+ * temporary std::string. Strings of any allocator (see Allocators.hpp) hash the same way.
+ * @tparam Alloc allocator of the strings
+ */
+template<typename Alloc>
+struct HashMapHash<std::basic_string<char, std::char_traits<char>, Alloc>>
+{
+    using is_transparent = void;
+
+    /**
+     * @param key characters to hash
+     * @return hash of key
+     */
+    size_t operator()(std::string_view key) const
+    {
+        return (size_t) hashing::hashBytes(key.data(), key.size());
+    }
+};
+
+
+/**
+ * A keyed hash function for keys which may come from an attacker: keys are hashed with SipHash-1-3
+ * under a 128 bit key drawn at random by every instance, so colliding keys can not be crafted in
+ * advance (hash flooding). It is slower than HashMapHash. It can be reseeded, which HashMap does
+ * when an insertion probes an over-long sequence of slots (see HashMapResizePolicy).
+ * Keys whose bytes identify them (integers, pointers, ...) are hashed by their bytes; other keys
+ * are hashed by their std::hash, so keys with the same std::hash still collide.
+ * @tparam KeyT type of keys
+ */
+template<typename KeyT>
+class SeededHash
+{
+    uint64_t _k0;
+    uint64_t _k1;
+
+public:
+    /**
+     * Constructor of a hash function with a random key.
+     */
+    SeededHash() : _k0(hashing::randomSeed()), _k1(hashing::randomSeed())
+    {}
+
+    /**
+     * Constructor of a hash function with a given key, e.g. to reproduce hashes in tests.
+     * @param k0 first half of the key
+     * @param k1 second half of the key
+     */
+    SeededHash(uint64_t k0, uint64_t k1) : _k0(k0), _k1(k1)
+    {}
+
+    /**
+     * Draws a new random key; every hash changes.
+     */
+    void reseed()
+    {
+        _k0 = hashing::randomSeed();
+        _k1 = hashing::randomSeed();
+    }
+
+    /**
+     * @param key key to hash
+     * @return hash of key
+     */
+    size_t operator()(const KeyT &key) const
+    {
+        if constexpr (std::has_unique_object_representations<KeyT>::value)
+        {
+            return (size_t) hashing::sipHash(&key, sizeof(KeyT), _k0, _k1);
+        }
+        else
+        {
+            size_t hash = std::hash<KeyT>()(key);
+            return (size_t) hashing::sipHash(&hash, sizeof(hash), _k0, _k1);
+        }
+    }
+};
+
+/**
+ * The keyed hash function of strings hashes their characters. Like the HashMapHash of strings, it
+ * is transparent, hashing any string-like argument as a std::string_view.
+ * @tparam Alloc allocator of the strings
+ */
+template<typename Alloc>
+class SeededHash<std::basic_string<char, std::char_traits<char>, Alloc>>
+{
+    uint64_t _k0;
+    uint64_t _k1;
+
+public:
+    using is_transparent = void;
+
+    /**
+     * Constructor of a hash function with a random key.
+     */
+    SeededHash() : _k0(hashing::randomSeed()), _k1(hashing::randomSeed())
+    {}
+
+    /**
+     * Constructor of a hash function with a given key, e.g. to reproduce hashes in tests.
+     * @param k0 first half of the key
+     * @param k1 second half of the key
+     */
+    SeededHash(uint64_t k0, uint64_t k1) : _k0(k0), _k1(k1)
+    {}
+
+    /**
+     * Draws a new random key; every hash changes.
+     */
+    void reseed()
+    {
+        _k0 = hashing::randomSeed();
+        _k1 = hashing::randomSeed();
+    }
+
+    /**
+     * @param key characters to hash
+     * @return hash of key
+     */
+    size_t operator()(std::string_view key) const
+    {
+        return (size_t) hashing::sipHash(key.data(), key.size(), _k0, _k1);
+    }
+};
+
+
+#endif //EX3_HASHMAPHASH_H
@@ -0,0 +1,388 @@
+// Tests of HashMap against std::unordered_map: random sequences of operations on both, checking
+// after every one that they agree, across load factors and resize policies, incremental rehash
+// steps, small (inline) and large (segmented) sizes, allocators, and copies, moves and swaps; and
+// targeted tests of reseeding on hash flooding and of find_batch. The probe compares a group of
+// control bytes at once, whose width is chosen at compile time, so build and run the tester once
+// per width, and with the statistics:
+//     g++ -std=c++17 HashMapTester.cpp -o tester && ./tester                         (16, SSE2)
+//     g++ -std=c++17 -mavx2 HashMapTester.cpp -o tester && ./tester                  (32, AVX2)
+//     g++ -std=c++17 -mno-sse2 HashMapTester.cpp -o tester && ./tester               (8, scalar)
+//     g++ -std=c++17 -DHASHMAP_ENABLE_STATS HashMapTester.cpp -o tester && ./tester
+
+#include "HashMap.hpp"
+#include "Allocators.hpp"
+#include <cassert>
+#include <random>
+#include <unordered_map>
+
+/**
+ * A hash function which maps every key to the same slot until it is reseeded, like keys crafted
+ * by an attacker against a known hash function.
+ */
+struct FloodedHash
+{
+    uint64_t seed = 0;
+
+    /**
+     * @param key key to hash
+     * @return hash of key
+     */
+    size_t operator()(long key) const
+    {
+        return seed == 0 ? 0 : (size_t) hashing::mix((uint64_t) key ^ seed);
+    }
+
+    /**
+     * Draws a new seed, which scatters the keys.
+     */
+    void reseed()
+    {
+        ++seed;
+    }
+};
+
+/**
+ * @param n number
+ * @return the n-th key of type long.
+ */
+long makeKey(long n, long)
+{
+    return n % 2 == 0 ? n : -n * 1000003;
+}
+
+/**
+ * @param n number
+ * @return the n-th key of type std::string; a third of them too long for the small string buffer.
+ */
+std::string makeKey(long n, const std::string &)
+{
+    return (n % 3 == 0 ? "a key too long for the small string buffer " : "k") + std::to_string(n);
+}
+
+/**
+ * Checks that a hashmap holds exactly the pairs of a reference map, by its iterators and by its
+ * lookups, and that it keeps within its upper load factor.
+ * @param map hashmap
+ * @param reference reference map
+ */
+template<typename Map, typename Reference>
+void checkSame(const Map &map, const Reference &reference)
+{
+    assert(map.size() == (int) reference.size());
+    assert(map.empty() == reference.empty());
+    assert(map.size() <= map.capacity() * map.resizePolicy().upperLoadFactor);
+    int visited = 0;
+    for (const auto &p : map)
+    {
+        auto found = reference.find(p.first);
+        assert(found != reference.end() && found->second == p.second);
+        ++visited;
+    }
+    assert(visited == map.size());
+    for (const auto &p : reference)
+    {
+        assert(map.containsKey(p.first));
+        assert(map.at(p.first) == p.second);
+        assert(map[p.first] == p.second);
+        assert(map.find(p.first)->second == p.second);
+    }
+}
+
+/**
+ * Applies random operations to a hashmap and to std::unordered_map, checking that they agree.
+ * @param map empty hashmap
+ * @param random random generator
+ * @param operations number of operations
+ * @param keyRange number of distinct keys drawn; small ranges keep the hashmap inline
+ */
+template<typename Map>
+void runDifferential(Map &map, std::mt19937 &random, int operations, long keyRange)
+{
+    using KeyT = typename std::decay<decltype(map.begin()->first)>::type;
+    std::unordered_map<KeyT, long> reference;
+    for (int i = 0; i < operations; ++i)
+    {
+        KeyT key = makeKey((long) (random() % keyRange), KeyT());
+        long value = (long) random();
+        unsigned int operation = random() % 100;
+        if (operation < 25)
+        {
+            assert(map.insert(key, value) == reference.insert({key, value}).second);
+        }
+        else if (operation < 35)
+        {
+            bool inserted = map.insert_or_assign(key, value).second;
+            assert(inserted == (reference.count(key) == 0));
+            reference[key] = value;
+        }
+        else if (operation < 40)
+        {
+            auto result = map.try_emplace(key, value);
+            auto expected = reference.try_emplace(key, value);
+            assert(result.second == expected.second);
+            assert(result.first->second == expected.first->second);
+        }
+        else if (operation < 45)
+        {
+            map[key] += value;
+            reference[key] += value;
+        }
+        else if (operation < 75)
+        {
+            assert(map.erase(key) == (reference.erase(key) == 1));
+        }
+        else if (operation < 90)
+        {
+            auto found = reference.find(key);
+            assert(map.containsKey(key) == (found != reference.end()));
+            assert((map.find(key) == map.end()) == (found == reference.end()));
+            if (found == reference.end())
+            {
+                bool thrown = false;
+                try
+                {
+                    map.at(key);
+                }
+                catch (std::out_of_range &e)
+                {
+                    thrown = true;
+                }
+                assert(thrown);
+            }
+        }
+        else if (operation < 92)
+        {
+            map.setRehashStep((int) (random() % 4) * 2);
+        }
+        else if (operation < 94)
+        {
+            Map copy(map); // copies and compares while a rehash may be under way
+            assert(copy == map);
+            checkSame(copy, reference);
+            KeyT absent = makeKey(keyRange, KeyT()); // never drawn
+            assert(copy.insert(absent, value) && copy != map && copy.erase(absent));
+            map = copy;
+        }
+        else if (operation < 96)
+        {
+            Map moved(std::move(map));
+            map = std::move(moved);
+            checkSame(moved, std::unordered_map<KeyT, long>()); // a moved-from map is empty
+        }
+        else if (operation < 97)
+        {
+            Map other(map.resizePolicy(), map.hash_function(), map.key_eq(), map.get_allocator());
+            other.insert(key, value);
+            map.swap(other);
+            checkSame(map, std::unordered_map<KeyT, long>{{key, value}});
+            map.swap(other);
+        }
+        else if (operation < 98)
+        {
+            map.reserve(random() % (size_t) (2 * keyRange));
+        }
+        else if (operation < 99)
+        {
+            if (random() % 2 == 0)
+            {
+                map.rehash(random() % (size_t) (4 * keyRange));
+            }
+            else
+            {
+                map.shrink_to_fit();
+            }
+        }
+        else if (random() % 20 == 0)
+        {
+            map.clear();
+            reference.clear();
+        }
+        assert(map.size() == (int) reference.size());
+        if (i % 64 == 0)
+        {
+            checkSame(map, reference);
+        }
+    }
+    checkSame(map, reference);
+}
+
+/**
+ * Runs the differential test on maps of the given type, with several resize policies, from small
+ * maps which stay inline to maps of thousands of keys.
+ * @tparam Map hashmap type
+ * @param random random generator
+ * @param makeMap function object returning an empty map for a resize policy
+ */
+template<typename Map, typename F>
+void runPolicies(std::mt19937 &random, F makeMap)
+{
+    HashMapResizePolicy policies[4];
+    policies[1].lowerLoadFactor = 0.1;
+    policies[1].upperLoadFactor = 0.9;
+    policies[2].shrinkHysteresis = 0.3;
+    policies[2].minCapacity = 64;
+    policies[2].shrinkDelay = 5;
+    policies[3].lowerLoadFactor = 0.4;
+    policies[3].upperLoadFactor = 0.5;
+    for (const HashMapResizePolicy &policy : policies)
+    {
+        for (long keyRange : {4L, 16L, 300L, 5000L})
+        {
+            Map map = makeMap(policy);
+            map.setRehashStep((int) (random() % 3));
+            runDifferential(map, random, 6000, keyRange);
+        }
+    }
+}
+
+void testLongKeys()
+{
+    std::mt19937 random(1);
+    runPolicies<HashMap<long, long>>(random, [](const HashMapResizePolicy &policy)
+    { return HashMap<long, long>(policy); });
+    std::cout << "passed test LongKeys\n";
+}
+
+void testStringKeys()
+{
+    std::mt19937 random(2);
+    runPolicies<HashMap<std::string, long>>(random, [](const HashMapResizePolicy &policy)
+    { return HashMap<std::string, long>(policy); });
+    std::cout << "passed test StringKeys\n";
+}
+
+void testSeededHash()
+{
+    std::mt19937 random(3);
+    using Map = HashMap<std::string, long, SeededHash<std::string>>;
+    runPolicies<Map>(random, [](const HashMapResizePolicy &policy)
+    { return Map(policy); });
+    std::cout << "passed test SeededHash\n";
+}
+
+void testAllocators()
+{
+    std::mt19937 random(4);
+    PoolResource pool;
+    using PoolMap = HashMap<long, long, HashMapHash<long>, std::equal_to<>,
+            PoolAllocator<std::pair<long, long>>>;
+    runPolicies<PoolMap>(random, [&pool](const HashMapResizePolicy &policy)
+    { return PoolMap(policy, HashMapHash<long>(), std::equal_to<>(), pool); });
+    MonotonicArena arena;
+    using ArenaMap = HashMap<long, long, HashMapHash<long>, std::equal_to<>,
+            ArenaAllocator<std::pair<long, long>>>;
+    ArenaMap map((ArenaAllocator<std::pair<long, long>>(arena)));
+    runDifferential(map, random, 20000, 3000);
+    std::cout << "passed test Allocators\n";
+}
+
+void testTransparentLookups()
+{
+    HashMap<std::string, int> map;
+    for (int i = 0; i < 1000; ++i)
+    {
+        map.insert(makeKey(i, std::string()), i);
+    }
+    for (int i = 0; i < 1000; ++i)
+    {
+        std::string key = makeKey(i, std::string());
+        assert(map.containsKey(std::string_view(key)) && map.at(key.c_str()) == i);
+        assert(map.find(std::string_view(key))->second == i);
+    }
+    assert(!map.containsKey("missing") && map.find(std::string_view("missing")) == map.end());
+    assert(map.erase(std::string_view(makeKey(7, std::string()))) && map.size() == 999);
+    const HashMap<std::string, int> &constMap = map;
+    bool thrown = false;
+    try
+    {
+        constMap["missing"];
+    }
+    catch (std::out_of_range &e)
+    {
+        thrown = true;
+    }
+    assert(thrown && constMap.size() == 999);
+    std::cout << "passed test TransparentLookups\n";
+}
+
+void testReseed()
+{
+    HashMapResizePolicy policy;
+    policy.maxProbeLength = 64;
+    HashMap<long, long, FloodedHash> map(policy);
+    std::unordered_map<long, long> reference;
+    for (long key = 0; key < 4000; ++key)
+    {
+        map.insert(key, key * 3);
+        reference[key] = key * 3;
+    }
+    assert(map.hash_function().seed != 0); // the colliding keys were rehashed with a new seed
+    checkSame(map, reference);
+    for (long key = 0; key < 4000; key += 2)
+    {
+        map.erase(key);
+        reference.erase(key);
+    }
+    checkSame(map, reference);
+    HashMapResizePolicy never;
+    never.maxProbeLength = 0;
+    HashMap<long, long, FloodedHash> flooded(never);
+    for (long key = 0; key < 1000; ++key)
+    {
+        flooded.insert(key, key);
+    }
+    assert(flooded.hash_function().seed == 0 && flooded.size() == 1000 && flooded.at(999) == 999);
+    std::cout << "passed test Reseed\n";
+}
+
+void testFindBatch()
+{
+    std::mt19937 random(5);
+    for (int keyCount : {0, 3, 100, 20000})
+    {
+        HashMap<long, long> map;
+        map.setRehashStep(keyCount % 7);
+        for (long key = 0; key < keyCount; ++key)
+        {
+            map.insert(makeKey(key, 0L), key);
+        }
+        std::vector<long> keys;
+        for (int i = 0; i < 1000; ++i)
+        {
+            keys.push_back(makeKey((long) (random() % (2 * keyCount + 1)), 0L));
+        }
+        std::vector<long *> values(keys.size());
+        std::vector<const long *> constValues(keys.size());
+        int found = map.find_batch(keys.data(), keys.size(), values.data());
+        const HashMap<long, long> &constMap = map;
+        assert(constMap.find_batch(keys.data(), keys.size(), constValues.data()) == found);
+        int expected = 0;
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            auto it = map.find(keys[i]);
+            assert(values[i] == (it == map.end() ? nullptr : &it->second));
+            assert(constValues[i] == values[i]);
+            expected += it != map.end();
+        }
+        assert(found == expected);
+    }
+    HashMap<std::string, long> strings;
+    strings.insert("spam", 1);
+    std::string_view keys[] = {"spam", "ham"};
+    long *values[2];
+    assert(strings.find_batch(keys, 2, values) == 1 && *values[0] == 1 && values[1] == nullptr);
+    std::cout << "passed test FindBatch\n";
+}
+
+int main()
+{
+    testLongKeys();
+    testStringKeys();
+    testSeededHash();
+    testAllocators();
+    testTransparentLookups();
+    testReseed();
+    testFindBatch();
+    std::cout << "good job!! you passed all tests!\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,577 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "HashMap.hpp"
+
+
+#ifndef EX3_MAPPEDHASHMAP_H
+#define EX3_MAPPEDHASHMAP_H
+
+/**
+ * A read-only view of a hashmap serialized to a file (see HashMap::serialize), used in place from a
+ * memory mapping of the file: opening it only maps the file and checks its header, and lookups
+ * read the mapped table directly, so there is no loading phase, and processes mapping the same file
+ * share its pages in the page cache.
+ * The file is position independent, referring to its parts by their offsets from its start. As in
+ * FrozenHashMap, its pairs are sorted by bucket, the pairs of bucket b being those between
+ * offsets[b] and offsets[b + 1], and their full hashes are kept in a parallel array. Keys are
+ * hashed with hashing::hashBytes and a random seed stored in the file, not with the hash function
+ * of the serialized hashmap, so the file does not depend on the process which wrote it.
+ * Keys are std::string, whose characters are stored in a byte area of the file and which are looked
+ * up as std::string_view, or trivially copyable types whose bytes identify them, stored as they
+ * are; values must be trivially copyable. The file has the byte order and type sizes of the
+ * machine which wrote it, and is rejected if its header does not match this build.
+ * @tparam KeyT key of type KeyT
+ * @tparam ValueT value of type ValueT
+ */
+template<typename KeyT, typename ValueT>
+class MappedHashMap
+{
+    static constexpr bool STRING_KEYS = std::is_same<KeyT, std::string>::value;
+    static_assert(STRING_KEYS || (std::is_trivially_copyable<KeyT>::value &&
+                                  std::has_unique_object_representations<KeyT>::value),
+                  "MappedHashMap keys must be std::string, or trivially copyable without padding");
+    static_assert(std::is_trivially_copyable<ValueT>::value,
+                  "MappedHashMap values must be trivially copyable");
+
+    static constexpr char MAGIC[8] = {'E', 'X', '3', 'H', 'M', 'A', 'P', '\0'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t SECTION_ALIGNMENT = 16;
+
+public:
+    /**
+     * Type of keys when looking up or iterating: std::string_view for std::string keys.
+     */
+    typedef typename std::conditional<STRING_KEYS, std::string_view, KeyT>::type key_view;
+
+private:
+    /**
+     * The characters of a string key, in the byte area of the file.
+     */
+    struct _StringRef
+    {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    using storedKey = typename std::conditional<STRING_KEYS, _StringRef, KeyT>::type;
+
+    /**
+     * A pair of the file.
+     */
+    struct _Record
+    {
+        storedKey key;
+        ValueT value;
+    };
+
+    static_assert(alignof(_Record) <= SECTION_ALIGNMENT, "MappedHashMap pairs are over-aligned");
+
+    /**
+     * Header of the file; every section offset is relative to the start of the file.
+     */
+    struct _Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t recordSize; // size of a pair of the writer, to reject other key or value types
+        uint64_t seed; // seed of the hashes of the keys
+        uint64_t size; // number of pairs
+        uint64_t buckets; // number of buckets, a power of 2
+        uint64_t offsetsAt; // buckets + 1 first pair indices, the last one being size
+        uint64_t hashesAt; // size hashes
+        uint64_t recordsAt; // size pairs
+        uint64_t bytesAt; // characters of the string keys, up to the end of the file
+        uint64_t fileSize;
+    };
+
+    const unsigned char *_base; // start of the mapping; nullptr if moved from
+    size_t _length; // length of the mapping
+    const _Header *_header;
+    const uint64_t *_offsets;
+    const uint64_t *_hashes;
+    const _Record *_records;
+    const char *_bytes;
+    uint64_t _bytesLength;
+
+// ================================ PRIVATE HELPER METHODS =======================================
+
+    /**
+     * @param offset offset in the file
+     * @return offset rounded up to the alignment of sections.
+     */
+    static uint64_t _align(uint64_t offset)
+    {
+        return (offset + SECTION_ALIGNMENT - 1) & ~(uint64_t) (SECTION_ALIGNMENT - 1);
+    }
+
+    /**
+     * @param key key to hash
+     * @param seed seed of the file
+     * @return hash of the key in a file of the given seed.
+     */
+    static uint64_t _hashKey(const key_view &key, uint64_t seed)
+    {
+        if constexpr (STRING_KEYS)
+        {
+            return hashing::hashBytes(key.data(), key.size(), seed);
+        }
+        else
+        {
+            return hashing::hashBytes(&key, sizeof(KeyT), seed);
+        }
+    }
+
+    /**
+     * @param at offset of a section
+     * @param count number of elements of the section
+     * @param elementSize size of an element
+     * @return true if the section is aligned and lies within the mapping; false otherwise.
+     */
+    bool _inFile(uint64_t at, uint64_t count, size_t elementSize) const
+    {
+        return at % SECTION_ALIGNMENT == 0 && at <= _length &&
+               count <= (_length - at) / elementSize;
+    }
+
+    /**
+     * Checks the header of the mapped file, and locates its sections. The sections themselves are
+     * not read, so corrupt offsets and string references are only detected by the lookups which
+     * read them.
+     * Throws std::invalid_argument if the file is not a table of this build and of these types.
+     */
+    void _attach()
+    {
+        _header = reinterpret_cast<const _Header *>(_base);
+        if (_length < sizeof(_Header) || std::memcmp(_header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            _header->version != VERSION || _header->recordSize != sizeof(_Record) ||
+            _header->fileSize != _length || _header->buckets == 0 ||
+            (_header->buckets & (_header->buckets - 1)) != 0 ||
+            !_inFile(_header->offsetsAt, _header->buckets + 1, sizeof(uint64_t)) ||
+            !_inFile(_header->hashesAt, _header->size, sizeof(uint64_t)) ||
+            !_inFile(_header->recordsAt, _header->size, sizeof(_Record)) ||
+            !_inFile(_header->bytesAt, 0, 1))
+        {
+            throw std::invalid_argument("Invalid table file");
+        }
+        _offsets = reinterpret_cast<const uint64_t *>(_base + _header->offsetsAt);
+        _hashes = reinterpret_cast<const uint64_t *>(_base + _header->hashesAt);
+        _records = reinterpret_cast<const _Record *>(_base + _header->recordsAt);
+        _bytes = reinterpret_cast<const char *>(_base + _header->bytesAt);
+        _bytesLength = _length - _header->bytesAt;
+    }
+
+    /**
+     * @param record pair of the file
+     * @return key of the pair; throws std::invalid_argument if it lies outside the file.
+     */
+    key_view _keyOf(const _Record &record) const
+    {
+        if constexpr (STRING_KEYS)
+        {
+            if (record.key.offset > _bytesLength ||
+                record.key.length > _bytesLength - record.key.offset)
+            {
+                throw std::invalid_argument("Invalid table file");
+            }
+            return std::string_view(_bytes + record.key.offset, (size_t) record.key.length);
+        }
+        else
+        {
+            return record.key;
+        }
+    }
+
+    /**
+     * @param key key to look for
+     * @return index of the pair of key if key exists; -1 otherwise.
+     */
+    int64_t _findIndex(const key_view &key) const
+    {
+        if (_base == nullptr)
+        {
+            return -1;
+        }
+        uint64_t hash = _hashKey(key, _header->seed);
+        uint64_t bucket = hash & (_header->buckets - 1);
+        uint64_t last = std::min(_offsets[bucket + 1], _header->size);
+        for (uint64_t i = _offsets[bucket]; i < last; ++i)
+        {
+            if (_hashes[i] == hash && _keyOf(_records[i]) == key)
+            {
+                return (int64_t) i;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * Unmaps the file, if mapped.
+     */
+    void _unmap() noexcept
+    {
+        if (_base != nullptr)
+        {
+            ::munmap(const_cast<unsigned char *>(_base), _length);
+            _base = nullptr;
+        }
+    }
+
+public:
+
+// ================================= CTORS, DTOR & RULE OF 5 =====================================
+
+    /**
+     * Constructor which maps a table file; its pages are only read when lookups need them.
+     * @param path path of a file written by HashMap::serialize
+     * Throws std::invalid_argument if the file can not be mapped, or is not a table of this build
+     * and of these key and value types.
+     */
+    explicit MappedHashMap(const std::string &path) : _base(nullptr), _length(0), _header(nullptr),
+                                                      _offsets(nullptr), _hashes(nullptr),
+                                                      _records(nullptr), _bytes(nullptr),
+                                                      _bytesLength(0)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+        {
+            throw std::invalid_argument("Invalid table file");
+        }
+        struct stat status{};
+        if (::fstat(fd, &status) == -1 || (size_t) status.st_size < sizeof(_Header))
+        {
+            ::close(fd);
+            throw std::invalid_argument("Invalid table file");
+        }
+        _length = (size_t) status.st_size;
+        void *base = ::mmap(nullptr, _length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // the mapping stays valid
+        if (base == MAP_FAILED)
+        {
+            throw std::invalid_argument("Invalid table file");
+        }
+        _base = static_cast<const unsigned char *>(base);
+        try
+        {
+            _attach();
+        }
+        catch (...)
+        {
+            _unmap();
+            throw;
+        }
+    }
+
+    /**
+     * Move constructor; other is left empty.
+     * @param other other mapped hashmap
+     */
+    MappedHashMap(MappedHashMap &&other) noexcept : _base(other._base), _length(other._length),
+                                                    _header(other._header),
+                                                    _offsets(other._offsets),
+                                                    _hashes(other._hashes),
+                                                    _records(other._records),
+                                                    _bytes(other._bytes),
+                                                    _bytesLength(other._bytesLength)
+    {
+        other._base = nullptr;
+    }
+
+    /**
+     * Move assignment operator; other is left empty.
+     * @param other other mapped hashmap
+     */
+    MappedHashMap &operator=(MappedHashMap &&other) noexcept
+    {
+        if (this != &other)
+        {
+            _unmap();
+            _base = other._base;
+            _length = other._length;
+            _header = other._header;
+            _offsets = other._offsets;
+            _hashes = other._hashes;
+            _records = other._records;
+            _bytes = other._bytes;
+            _bytesLength = other._bytesLength;
+            other._base = nullptr;
+        }
+        return *this;
+    }
+
+    MappedHashMap(const MappedHashMap &other) = delete;
+
+    MappedHashMap &operator=(const MappedHashMap &other) = delete;
+
+    /**
+     * Destructor, unmaps the file.
+     */
+    ~MappedHashMap()
+    {
+        _unmap();
+    }
+
+// ======================================= API METHODS ===========================================
+
+    /**
+     * Writes a hashmap to a table file. The file is written under a unique temporary name in the
+     * same directory, synced to disk, and then renamed, so processes which mapped a previous
+     * version of it keep reading that version, and concurrent writers each publish a whole file.
+     * @param map hashmap to write
+     * @param path path of the table file
+     * Throws std::invalid_argument if the file can not be written.
+     */
+    template<typename Hash, typename KeyEqual, typename Allocator>
+    static void write(const HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator> &map,
+                      const std::string &path)
+    {
+        std::random_device device;
+        _Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.recordSize = sizeof(_Record);
+        header.seed = ((uint64_t) device() << 32) ^ device();
+        header.size = (uint64_t) map.size();
+        header.buckets = 1;
+        while (header.buckets < header.size)
+        {
+            header.buckets <<= 1;
+        }
+        std::vector<uint64_t> offsets(header.buckets + 1, 0);
+        std::vector<uint64_t> hashes; // hash of every pair of map, in iteration order
+        hashes.reserve(map.size());
+        for (const auto &p : map)
+        {
+            hashes.push_back(_hashKey(p.first, header.seed));
+            ++offsets[(hashes.back() & (header.buckets - 1)) + 1];
+        }
+        for (uint64_t b = 0; b < header.buckets; ++b)
+        {
+            offsets[b + 1] += offsets[b];
+        }
+        std::vector<uint64_t> next(offsets.begin(), offsets.end() - 1);
+        std::vector<const std::pair<KeyT, ValueT> *> sorted(map.size());
+        std::vector<uint64_t> sortedHashes(map.size());
+        size_t i = 0;
+        for (const auto &p : map)
+        {
+            uint64_t at = next[hashes[i] & (header.buckets - 1)]++;
+            sorted[at] = &p;
+            sortedHashes[at] = hashes[i++];
+        }
+        std::vector<_Record> records(map.size());
+        std::string bytes;
+        for (size_t r = 0; r < sorted.size(); ++r)
+        {
+            if constexpr (STRING_KEYS)
+            {
+                records[r].key = _StringRef{bytes.size(), sorted[r]->first.size()};
+                bytes += sorted[r]->first;
+            }
+            else
+            {
+                records[r].key = sorted[r]->first;
+            }
+            records[r].value = sorted[r]->second;
+        }
+        header.offsetsAt = _align(sizeof(_Header));
+        header.hashesAt = _align(header.offsetsAt + offsets.size() * sizeof(uint64_t));
+        header.recordsAt = _align(header.hashesAt + sortedHashes.size() * sizeof(uint64_t));
+        header.bytesAt = _align(header.recordsAt + records.size() * sizeof(_Record));
+        header.fileSize = header.bytesAt + bytes.size();
+        std::vector<char> file(header.fileSize, 0);
+        std::memcpy(file.data(), &header, sizeof(header));
+        std::memcpy(file.data() + header.offsetsAt, offsets.data(),
+                    offsets.size() * sizeof(uint64_t));
+        if (!records.empty())
+        {
+            std::memcpy(file.data() + header.hashesAt, sortedHashes.data(),
+                        sortedHashes.size() * sizeof(uint64_t));
+            std::memcpy(file.data() + header.recordsAt, records.data(),
+                        records.size() * sizeof(_Record));
+            std::memcpy(file.data() + header.bytesAt, bytes.data(), bytes.size());
+        }
+        // a unique temporary in the same directory, so concurrent writers never share one, and
+        // the rename stays within one file system
+        std::string temporary = path + ".XXXXXX";
+        int fd = ::mkstemp(&temporary[0]);
+        if (fd == -1)
+        {
+            throw std::invalid_argument("Could not write table file");
+        }
+        bool written = ::fchmod(fd, 0644) == 0;
+        for (size_t done = 0; written && done < file.size();)
+        {
+            ssize_t n = ::write(fd, file.data() + done, file.size() - done);
+            if (n > 0)
+            {
+                done += (size_t) n;
+            }
+            else if (n == -1 && errno != EINTR)
+            {
+                written = false;
+            }
+        }
+        // the data reaches the disk before the rename publishes it
+        written = written && ::fsync(fd) == 0;
+        written = ::close(fd) == 0 && written;
+        if (!written || std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            ::unlink(temporary.c_str());
+            throw std::invalid_argument("Could not write table file");
+        }
+    }
+
+    /**
+     * @param path path of a file
+     * @return true if the file starts like a table file; false otherwise.
+     */
+    static bool isTableFile(const std::string &path)
+    {
+        char magic[sizeof(MAGIC)];
+        std::ifstream file(path, std::ios::binary);
+        return file.read(magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    }
+
+    /**
+     * @return number of pairs.
+     */
+    int size() const
+    { return _base == nullptr ? 0 : (int) _header->size; }
+
+    /**
+     * @return true if there are no pairs; false otherwise.
+     */
+    bool empty() const
+    { return size() == 0; }
+
+    /**
+     * @param key key to look for
+     * @return pointer to the value of key in the mapping if key exists; nullptr otherwise.
+     */
+    const ValueT *find(const key_view &key) const
+    {
+        int64_t i = _findIndex(key);
+        return i == -1 ? nullptr : &_records[i].value;
+    }
+
+    /**
+     * @param key key to look for
+     * @return true if key exists; false otherwise.
+     */
+    bool containsKey(const key_view &key) const
+    { return _findIndex(key) != -1; }
+
+    /**
+     * @param key key to look for
+     * @return value of key if key exists; throws std::out_of_range otherwise.
+     */
+    const ValueT &at(const key_view &key) const
+    {
+        int64_t i = _findIndex(key);
+        if (i == -1)
+        {
+            throw std::out_of_range("Invalid key");
+        }
+        return _records[i].value;
+    }
+
+// ======================================= ITERATOR ==============================================
+
+    /**
+     * Iterator over the pairs, in bucket order. Dereferencing it decodes a pair of the mapping
+     * into a std::pair<key_view, ValueT>, which it returns by value.
+     */
+    class const_iterator
+    {
+        const MappedHashMap *_map;
+        uint64_t _index;
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<key_view, ValueT>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        /**
+         * Constructor for an iterator pointing to a given pair.
+         * @param map mapped hashmap
+         * @param index index of a pair
+         */
+        const_iterator(const MappedHashMap *map, uint64_t index) : _map(map), _index(index)
+        {}
+
+        /**
+         * @return the current pair.
+         */
+        value_type operator*() const
+        {
+            const _Record &record = _map->_records[_index];
+            return value_type(_map->_keyOf(record), record.value);
+        }
+
+        /**
+         * Prefix ++ operator.
+         * @return this iterator
+         */
+        const_iterator &operator++()
+        {
+            ++_index;
+            return *this;
+        }
+
+        /**
+         * Post fix ++ operator.
+         * @return this iterator, before it was incremented
+         */
+        const_iterator operator++(int)
+        {
+            const_iterator temp = *this;
+            ++_index;
+            return temp;
+        }
+
+        /**
+         * @return true if both iterators point to the same pair; false otherwise.
+         */
+        bool operator==(const const_iterator &rhs) const
+        { return _map == rhs._map && _index == rhs._index; }
+
+        /**
+         * @return false if both iterators point to the same pair; true otherwise.
+         */
+        bool operator!=(const const_iterator &rhs) const
+        { return !(*this == rhs); }
+    };
+
+    /**
+     * @return iterator to the first pair.
+     */
+    const_iterator begin() const
+    { return const_iterator(this, 0); }
+
+    /**
+     * @return iterator past the last pair.
+     */
+    const_iterator end() const
+    { return const_iterator(this, (uint64_t) size()); }
+};
+
+
+#endif //EX3_MAPPEDHASHMAP_H
@@ -0,0 +1,677 @@
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "HashMapHash.hpp"
+
+
+#ifndef EX3_ORDEREDHASHMAP_H
+#define EX3_ORDEREDHASHMAP_H
+
+/**
+ * A hashmap which keeps its pairs in insertion order, even across erasures, in the style of
+ * CPython's dict: the pairs are appended to a vector of entries, and the table is a compact index
+ * of slots, each holding the position of an entry (or EMPTY, or DUMMY for an erased one).
+ * The index uses the narrowest integers able to address all entries, 1 byte per slot for up to 128
+ * slots, then 2, then 4, so for small and medium maps the table is a few bytes per slot.
+ * Erasing a key leaves a hole in the entries; holes are dropped whenever the index is rebuilt.
+ * Iteration walks the entries in order, so the output of a map depends only on the sequence of
+ * operations applied to it.
+ * Collisions are resolved by linear probing; the full hash of every key is stored in its entry.
+ * @tparam KeyT key of type KeyT
+ * @tparam ValueT value of type ValueT
+ * @tparam Hash hash function object of keys; HashMapHash by default
+ * @tparam KeyEqual equality predicate of keys; operator== by default
+ */
+template<typename KeyT, typename ValueT, typename Hash = HashMapHash<KeyT>,
+        typename KeyEqual = std::equal_to<>>
+class OrderedHashMap
+{
+    using pair = std::pair<KeyT, ValueT>;
+
+    /**
+     * An inserted pair, empty once its key was erased.
+     */
+    struct entry
+    {
+        size_t hash;
+        std::optional<pair> kv;
+    };
+
+    static constexpr int32_t EMPTY = -1;
+    static constexpr int32_t DUMMY = -2;
+    static constexpr int INITIAL_CAPACITY = 16;
+
+    int _size; // number of pairs, i.e. entries which are not holes
+    int _occupied; // number of slots which are not EMPTY
+    int _capacity; // number of slots of the index
+    int _width; // bytes per slot of the index: 1, 2 or 4
+    double _upperLoadFactor;
+    double _lowerLoadFactor;
+    std::vector<unsigned char> _indices; // position of the entry of every slot, EMPTY or DUMMY
+    std::vector<entry> _entries; // in insertion order, holes included
+    Hash _hashFunction;
+    KeyEqual _keyEqual;
+
+// ================================ PRIVATE HELPER METHODS =======================================
+
+    /**
+     * @param i index of a slot
+     * @return content of the slot.
+     */
+    int32_t _slotAt(int i) const
+    {
+        const unsigned char *p = _indices.data() + (size_t) i * _width;
+        switch (_width)
+        {
+            case 1:
+                return (int8_t) *p;
+            case 2:
+            {
+                int16_t v;
+                std::memcpy(&v, p, 2);
+                return v;
+            }
+            default:
+            {
+                int32_t v;
+                std::memcpy(&v, p, 4);
+                return v;
+            }
+        }
+    }
+
+    /**
+     * @param i index of a slot
+     * @param value new content of the slot
+     */
+    void _setSlot(int i, int32_t value)
+    {
+        unsigned char *p = _indices.data() + (size_t) i * _width;
+        switch (_width)
+        {
+            case 1:
+                *p = (unsigned char) (int8_t) value;
+                break;
+            case 2:
+            {
+                int16_t v = (int16_t) value;
+                std::memcpy(p, &v, 2);
+                break;
+            }
+            default:
+                std::memcpy(p, &value, 4);
+        }
+    }
+
+    /**
+     * Finds the slot of a key.
+     * @param key key to look for
+     * @param hash full hash of key
+     * @return index of the slot referring to the entry of key if key exists; -1 otherwise.
+     */
+    int _findSlot(const KeyT &key, size_t hash) const
+    {
+        int mask = _capacity - 1;
+        for (int i = (int) (hash & (size_t) mask);; i = (i + 1) & mask)
+        {
+            int32_t e = _slotAt(i);
+            if (e == EMPTY)
+            {
+                return -1;
+            }
+            if (e != DUMMY && _entries[e].hash == hash && _keyEqual(_entries[e].kv->first, key))
+            {
+                return i;
+            }
+        }
+    }
+
+    /**
+     * @param key key to look for
+     * @return position of the entry of key if key exists; -1 otherwise.
+     */
+    int _findEntry(const KeyT &key) const
+    {
+        int i = _findSlot(key, _hashFunction(key));
+        return i == -1 ? -1 : _slotAt(i);
+    }
+
+    /**
+     * @param count number of entries
+     * @return the smallest power of 2, at least INITIAL_CAPACITY, which holds count entries
+     * without exceeding the upper load factor.
+     */
+    int _capacityFor(size_t count) const
+    {
+        size_t capacity = INITIAL_CAPACITY;
+        while ((double) count / (double) capacity > _upperLoadFactor)
+        {
+            if (capacity > (size_t) INT32_MAX / 2)
+            {
+                throw std::length_error("OrderedHashMap capacity overflow");
+            }
+            capacity *= 2;
+        }
+        return (int) capacity;
+    }
+
+    /**
+     * Drops the holes of the entries, and rebuilds the index with the given capacity, with slots
+     * as narrow as the capacity allows.
+     * @param capacity number of slots, a power of 2 large enough for all elements
+     */
+    void _rebuild(int capacity)
+    {
+        if (_size != (int) _entries.size())
+        {
+            std::vector<entry> packed;
+            packed.reserve(_entries.capacity());
+            for (entry &e : _entries)
+            {
+                if (e.kv)
+                {
+                    packed.push_back(std::move(e));
+                }
+            }
+            _entries.swap(packed);
+        }
+        _capacity = capacity;
+        _occupied = (int) _entries.size();
+        _width = capacity <= INT8_MAX + 1 ? 1 : capacity <= INT16_MAX + 1 ? 2 : 4;
+        _indices.assign((size_t) capacity * _width, 0xFF); // every slot EMPTY
+        int mask = _capacity - 1;
+        for (int e = 0; e < (int) _entries.size(); ++e)
+        {
+            int i = (int) (_entries[e].hash & (size_t) mask);
+            while (_slotAt(i) != EMPTY)
+            {
+                i = (i + 1) & mask;
+            }
+            _setSlot(i, e);
+        }
+    }
+
+    /**
+     * Appends a pair whose key does not exist. Occupied slots, DUMMY ones included, are kept under
+     * the upper load factor, which also guarantees every probe sequence meets an EMPTY slot.
+     * @param hash full hash of key
+     * @param key key of pair
+     * @param value value of pair
+     * @return position of the new entry.
+     */
+    template<typename K, typename V>
+    int _append(size_t hash, K &&key, V &&value)
+    {
+        if ((double) (_occupied + 1) / (double) _capacity > _upperLoadFactor)
+        {
+            _rebuild(_capacityFor((size_t) _size + 1));
+        }
+        int mask = _capacity - 1;
+        int i = (int) (hash & (size_t) mask);
+        while (_slotAt(i) != EMPTY) // a DUMMY is not reused, it may be on the way to another key
+        {
+            i = (i + 1) & mask;
+        }
+        _entries.push_back({hash, pair(std::forward<K>(key), std::forward<V>(value))});
+        _setSlot(i, (int32_t) _entries.size() - 1);
+        ++_occupied;
+        ++_size;
+        return (int) _entries.size() - 1;
+    }
+
+    /**
+     * Inserts a pair if its key does not exist.
+     * @param key key of pair
+     * @param value value of pair if inserted
+     * @return true if insertion was performed; false otherwise.
+     */
+    template<typename K, typename V>
+    bool _insert(K &&key, V &&value)
+    {
+        size_t hash = _hashFunction(key);
+        if (_findSlot(key, hash) != -1)
+        {
+            return false;
+        }
+        _append(hash, std::forward<K>(key), std::forward<V>(value));
+        return true;
+    }
+
+public:
+    template<bool IsConst>
+    class basicIterator;
+
+    /**
+     * Iterator over mutable pairs, in insertion order; the key of a pair must not be modified
+     * through it.
+     */
+    typedef basicIterator<false> iterator;
+
+    /**
+     * Iterator over const pairs, in insertion order.
+     */
+    typedef basicIterator<true> const_iterator;
+
+// ================================= CTORS, DTOR & RULE OF 5 =====================================
+
+    /**
+     * Default constructor for ordered hash map.
+     */
+    OrderedHashMap() : OrderedHashMap(0.25, 0.75)
+    {}
+
+    /**
+     * Constructor which receives specific lower and upper load factors;
+     * @param lowerLoadFactor lower load factor
+     * @param upperLoadFactor upper load factor
+     * @param hash hash function object
+     * @param equal equality predicate
+     */
+    OrderedHashMap(double lowerLoadFactor, double upperLoadFactor, const Hash &hash = Hash(),
+                   const KeyEqual &equal = KeyEqual()) : _size(0), _occupied(0), _capacity(0),
+                                                         _width(1),
+                                                         _upperLoadFactor(upperLoadFactor),
+                                                         _lowerLoadFactor(lowerLoadFactor),
+                                                         _hashFunction(hash), _keyEqual(equal)
+    {
+        if (lowerLoadFactor >= upperLoadFactor || lowerLoadFactor <= 0 || upperLoadFactor >= 1)
+        {
+            throw std::invalid_argument("Invalid load factors");
+        }
+        _rebuild(INITIAL_CAPACITY);
+    }
+
+    /**
+     * Builds an ordered hashmap from 2 vectors of keys and values; the order of the pairs is the
+     * order of the first occurrence of every key, which is mapped to its last value.
+     * @param keys vector containing keys
+     * @param values vector containing values
+     */
+    OrderedHashMap(const std::vector<KeyT> &keys, const std::vector<ValueT> &values)
+            : OrderedHashMap()
+    {
+        if (keys.size() != values.size())
+        {
+            throw std::invalid_argument("Vectors size is not equal");
+        }
+        reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            insert_or_assign(keys[i], values[i]);
+        }
+    }
+
+// ======================================= API METHODS ===========================================
+
+    /**
+     * @return size of hashmap, i.e. number of elements.
+     */
+    int size() const
+    { return _size; }
+
+    /**
+     * @return capacity of hashmap, i.e. number of slots of the index.
+     */
+    int capacity() const
+    { return _capacity; }
+
+    /**
+     * @return current load factor of hashmap.
+     */
+    double getLoadFactor() const
+    { return ((double) _size / (double) _capacity); }
+
+    /**
+     * @return true if hash map is empty; false otherwise.
+     */
+    bool empty() const
+    { return _size == 0; }
+
+    /**
+     * Insert a pair of <key,value> at the end of the hashmap, if key does not exist.
+     * @param key key of pair
+     * @param value value of pair
+     * @return true is insertion was performed; false otherwise.
+     */
+    bool insert(const KeyT &key, const ValueT &value)
+    {
+        return _insert(key, value);
+    }
+
+    /**
+     * Insert a pair of <key,value> at the end of the hashmap, if key does not exist, moving key
+     * and value into it.
+     * @param key key of pair
+     * @param value value of pair
+     * @return true is insertion was performed; false otherwise.
+     */
+    bool insert(KeyT &&key, ValueT &&value)
+    {
+        return _insert(std::move(key), std::move(value));
+    }
+
+    /**
+     * Assigns value to key if key exists, which keeps its place; otherwise, inserts a pair of
+     * <key,value> at the end.
+     * @param key key of pair
+     * @param value value to assign or insert
+     * @return iterator to the pair of key, and true if insertion was performed.
+     */
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(const KeyT &key, M &&value)
+    {
+        size_t hash = _hashFunction(key);
+        int slot = _findSlot(key, hash);
+        if (slot != -1)
+        {
+            int e = _slotAt(slot);
+            _entries[e].kv->second = std::forward<M>(value);
+            return {iterator(this, e), false};
+        }
+        return {iterator(this, _append(hash, key, std::forward<M>(value))), true};
+    }
+
+    /**
+     * @param key key of type KeyT
+     * @return iterator to the pair of key if key exists; end() otherwise.
+     */
+    iterator find(const KeyT &key)
+    {
+        int e = _findEntry(key);
+        return e == -1 ? end() : iterator(this, e);
+    }
+
+    /**
+     * @param key key of type KeyT
+     * @return const iterator to the pair of key if key exists; end() otherwise.
+     */
+    const_iterator find(const KeyT &key) const
+    {
+        int e = _findEntry(key);
+        return e == -1 ? end() : const_iterator(this, e);
+    }
+
+    /**
+     * @param key key of KeyT
+     * @return true if key exists in hashmap.
+     */
+    bool containsKey(const KeyT &key) const
+    {
+        return _findEntry(key) != -1;
+    }
+
+    /**
+     * @param key key of type KeyT
+     * @return returns reference to value of the key if key exists; throws std::out_of_range
+     * otherwise.
+     */
+    ValueT &at(const KeyT &key)
+    {
+        int e = _findEntry(key);
+        if (e == -1)
+        {
+            throw std::out_of_range("Invalid key");
+        }
+        return _entries[e].kv->second;
+    }
+
+    /**
+     * @param key key of type KeyT
+     * @return returns const reference to value of the key if key exists; throws std::out_of_range
+     * otherwise.
+     */
+    const ValueT &at(const KeyT &key) const
+    {
+        int e = _findEntry(key);
+        if (e == -1)
+        {
+            throw std::out_of_range("Invalid key");
+        }
+        return _entries[e].kv->second;
+    }
+
+    /**
+     * Removes a key from hashmap if key exists; the other pairs keep their order. If the
+     * elements fall under the lower load factor, the index is rebuilt at half its capacity (but
+     * never under the initial capacity).
+     * @param key key of type KeyT
+     * @return true if key was successfully was erased; false otherwise.
+     */
+    bool erase(const KeyT &key)
+    {
+        int slot = _findSlot(key, _hashFunction(key));
+        if (slot == -1)
+        {
+            return false;
+        }
+        _entries[_slotAt(slot)].kv.reset();
+        _setSlot(slot, DUMMY); // the slot may be on the probe sequences of other keys
+        --_size;
+        while (!_entries.empty() && !_entries.back().kv) // trailing holes can be dropped right away
+        {
+            _entries.pop_back();
+        }
+        if (getLoadFactor() < _lowerLoadFactor && _capacity > INITIAL_CAPACITY &&
+            (double) _size / (double) (_capacity / 2) <= _upperLoadFactor)
+        {
+            _rebuild(_capacity / 2);
+        }
+        return true;
+    }
+
+    /**
+     * clear the hashmap from all the elements.
+     */
+    void clear()
+    {
+        _entries.clear();
+        _size = 0;
+        _rebuild(_capacity);
+    }
+
+    /**
+     * Makes room for at least count elements, so that inserting them does not rebuild the index.
+     * @param count number of elements
+     */
+    void reserve(size_t count)
+    {
+        int capacity = _capacityFor(count);
+        _entries.reserve(count);
+        if (capacity > _capacity)
+        {
+            _rebuild(capacity);
+        }
+    }
+
+// ================================= OPERATORS OVERLOADING =======================================
+
+    /**
+     * equality comparison operator overloading; the order of the pairs does not matter.
+     * @param other other hashmap to compare to
+     * @return true if hashmap are identical; false otherwise;
+     */
+    bool operator==(const OrderedHashMap &other) const
+    {
+        if (_size != other._size)
+        {
+            return false;
+        }
+        for (const pair &p : *this)
+        {
+            int e = other._findEntry(p.first);
+            if (e == -1 || !(other._entries[e].kv->second == p.second))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+    * inequality comparison operator overloading.
+    * @param other other hashmap to compare to
+    * @return false if hashmap are identical; true otherwise;
+    */
+    bool operator!=(const OrderedHashMap &other) const
+    {
+        return !(*this == other);
+    }
+
+    /**
+     * [] operator overloading.
+     * @param key key of type KeyT
+     * @return reference to the value of key if key exists; else inserts a default ValueT at the
+     * end and returns a reference to it.
+     */
+    ValueT &operator[](const KeyT &key)
+    {
+        size_t hash = _hashFunction(key);
+        int slot = _findSlot(key, hash);
+        int e = slot != -1 ? _slotAt(slot) : _append(hash, key, ValueT());
+        return _entries[e].kv->second;
+    }
+
+// ======================================= ITERATOR ==============================================
+
+    /**
+     * Iterator for ordered hashmap, walking the entries in insertion order and skipping holes.
+     * @tparam IsConst true for an iterator over const pairs
+     */
+    template<bool IsConst>
+    class basicIterator
+    {
+        friend class OrderedHashMap;
+        using mapT = typename std::conditional<IsConst, const OrderedHashMap,
+                OrderedHashMap>::type;
+        using pairT = typename std::conditional<IsConst, const pair, pair>::type;
+
+        mapT *_map; // pointer to map
+        int _entry; // position of current entry, number of entries at end
+
+        /**
+         * Advances _entry to the first entry which is not a hole, starting from its current one.
+         */
+        void _skipHoles()
+        {
+            while (_entry < (int) _map->_entries.size() && !_map->_entries[_entry].kv)
+            {
+                ++_entry;
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = pair;
+        using difference_type = std::ptrdiff_t;
+        using pointer = pairT *;
+        using reference = pairT &;
+
+        /**
+         * Constructor for an iterator pointing to a given entry, or to the next pair after it.
+         * @param map hashmap pointer
+         * @param entry position of an entry
+         */
+        basicIterator(mapT *map, int entry) : _map(map), _entry(entry)
+        {
+            _skipHoles();
+        }
+
+        /**
+         * Conversion of an iterator to a const iterator.
+         * @return const iterator pointing to the same pair
+         */
+        operator basicIterator<true>() const
+        {
+            return basicIterator<true>(_map, _entry);
+        }
+
+        /**
+         * Prefix ++ operator.
+         * @return this iterator
+         */
+        basicIterator &operator++()
+        {
+            ++_entry;
+            _skipHoles();
+            return *this;
+        }
+
+        /**
+         * Post fix ++ operator.
+         * @return this iterator
+         */
+        basicIterator operator++(int)
+        {
+            basicIterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+
+        /**
+         * Dereference operator.
+         * @return reference to the current pair
+         */
+        pairT &operator*() const
+        { return *_map->_entries[_entry].kv; }
+
+        /**
+        * Arrow operator.
+        * @return pointer to the current pair
+        */
+        pairT *operator->() const
+        { return &*_map->_entries[_entry].kv; }
+
+        /**
+         * Equality comparison operator.
+         * @param rhs other iterator
+         * @return true if iterators are identical; false otherwise.
+         */
+        bool operator==(const basicIterator &rhs) const
+        {
+            return (_map == rhs._map && _entry == rhs._entry);
+        }
+
+        /**
+        * Inequality comparison operator.
+        * @param rhs other iterator
+        * @return false if iterators are identical; true otherwise.
+        */
+        bool operator!=(const basicIterator &rhs) const
+        {
+            return !(*this == rhs);
+        }
+    };
+
+    /**
+     * @return first pair of hashmap, the earliest inserted.
+     */
+    iterator begin()
+    { return iterator(this, 0); }
+
+    /**
+    * @return end of hashmap.
+    */
+    iterator end()
+    { return iterator(this, (int) _entries.size()); }
+
+    /**
+     * @return first pair of hashmap, the earliest inserted.
+     */
+    const_iterator begin() const
+    { return const_iterator(this, 0); }
+
+    /**
+    * @return end of hashmap.
+    */
+    const_iterator end() const
+    { return const_iterator(this, (int) _entries.size()); }
+};
+
+
+#endif //EX3_ORDEREDHASHMAP_H
@@ -4,8 +4,44 @@
 
 #include <iostream>
 #include "HashMap.hpp"
+#include "MappedHashMap.hpp"
+#include "AhoCorasick.hpp"
+#include "ThreadPool.hpp"
 #include <fstream>
 #include <sstream>
+#include <memory>
+#include <condition_variable>
+#include <filesystem>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define USAGE "Usage: SpamDetector <database path> <message path> <threshold>\n" \
+              "       SpamDetector --compile <database path> <table path>\n" \
+              "       SpamDetector --serve <database path> <threshold> [socket path]\n" \
+              "       SpamDetector --batch <database path> <threshold> <directory or manifest>" \
+              " [threads]"
+#define COMPILE_FLAG "--compile"
+#define SERVE_FLAG "--serve"
+#define BATCH_FLAG "--batch"
+#define MAX_THREADS 1024
+#define READ_SIZE 65536
+#define MAX_HEADER_LENGTH 32
+#define MAX_LENGTH_DIGITS 9
+#define SERVE_WORKERS 32
+#define SOCKET_BACKLOG 128
 
 /**
  * Checks if a string is a valid positive integer
@@ -92,40 +128,129 @@ parseDatabase(std::ifstream &database, std::vector<std::string> &phrases, std::v
                 }
             }
         }
-        phrases.push_back(phrase);
+        phrases.push_back(std::move(phrase));
         scores.push_back(score);
     }
 }
 
 /**
- * Parses the message file.
+ * Loads the database, and compiles its phrases into an automaton matching all of them at once.
+ * @param database database file, either a database or a table file compiled with --compile
+ * @param path path of the database file
+ * @return automaton of the phrases of the database
+ */
+AhoCorasick loadDatabase(std::ifstream &database, const char *path)
+{
+    if (MappedHashMap<std::string, int>::isTableFile(path))
+    {
+        database.close();
+        MappedHashMap<std::string, int> table(path);
+        return AhoCorasick(table);
+    }
+    std::vector<std::string> phrases;
+    std::vector<int> scores;
+    parseDatabase(database, phrases, scores);
+    database.close();
+    // keyed hashing: crafted phrases can not collide in the table
+    HashMap<std::string, int, SeededHash<std::string>> map(std::move(phrases), std::move(scores));
+    return AhoCorasick(map);
+}
+
+/**
+ * Loads the database to be shared by threads, see loadDatabase; errors are reported to std::cerr.
+ * @param database database file, either a database or a table file compiled with --compile
+ * @param path path of the database file
+ * @return automaton of the phrases of the database; nullptr in cases of invalid database, or memory
+ * error.
+ */
+std::shared_ptr<const AhoCorasick> loadSharedDatabase(std::ifstream &database, const char *path)
+{
+    try
+    {
+        return std::make_shared<const AhoCorasick>(loadDatabase(database, path));
+    }
+    catch (std::bad_alloc &e)
+    {
+        std::cerr << "Memory allocation failed." << std::endl;
+    }
+    catch (std::invalid_argument &e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+    return nullptr;
+}
+
+/**
+ * Converts a chunk of a message to lower case, and replaces its newlines and tabs by spaces, in one
+ * pass, like AhoCorasick::normalize does the phrases. The bytes are done 32 (AVX2) or 16 (SSE2) at
+ * once when the compiler targets them, and the rest one by one with AhoCorasick::normalize.
+ * @param chunk chunk of a message
+ */
+void normalizeMessage(std::string &chunk)
+{
+    char *text = chunk.data();
+    size_t length = chunk.size();
+    size_t i = 0;
+#if defined(__AVX2__)
+    // 'A'..'Z' are shifted to the 26 smallest signed bytes, so one signed comparison finds them
+    const __m256i shift = _mm256_set1_epi8((char) (0x80 - 'A'));
+    const __m256i upperEnd = _mm256_set1_epi8((char) (-0x80 + 26));
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i space = _mm256_set1_epi8(' ');
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+        __m256i upper = _mm256_cmpgt_epi8(upperEnd, _mm256_add_epi8(bytes, shift));
+        bytes = _mm256_or_si256(bytes, _mm256_and_si256(upper, caseBit));
+        __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, newline),
+                                        _mm256_cmpeq_epi8(bytes, tab));
+        bytes = _mm256_blendv_epi8(bytes, space, blank);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(text + i), bytes);
+    }
+#elif defined(__SSE2__)
+    // 'A'..'Z' are shifted to the 26 smallest signed bytes, so one signed comparison finds them
+    const __m128i shift = _mm_set1_epi8((char) (0x80 - 'A'));
+    const __m128i upperEnd = _mm_set1_epi8((char) (-0x80 + 26));
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i space = _mm_set1_epi8(' ');
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        __m128i upper = _mm_cmplt_epi8(_mm_add_epi8(bytes, shift), upperEnd);
+        bytes = _mm_or_si128(bytes, _mm_and_si128(upper, caseBit));
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(bytes, newline), _mm_cmpeq_epi8(bytes, tab));
+        bytes = _mm_or_si128(_mm_andnot_si128(blank, bytes), _mm_and_si128(blank, space));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(text + i), bytes);
+    }
+#endif
+    for (; i < length; ++i)
+    {
+        text[i] = AhoCorasick::normalize(text[i]);
+    }
+}
+
+/**
+ * Parses the message file, in chunks of READ_SIZE bytes, so only one chunk is in memory at a time.
  * @param message message file
- * @param map HashMap of pairs
+ * @param scanner scanner of the automaton of the phrases of the database; the automaton carries
+ * its state over from chunk to chunk, so phrases spanning two chunks are matched
  * @return total score of message
  */
-int parseMessage(std::ifstream &message, HashMap<std::string, int> &map)
+int parseMessage(std::istream &message, AhoCorasick::Scanner &scanner)
 {
+    std::string chunk(READ_SIZE, '\0');
     int score = 0;
-    // read the message into string and convert it to lower case, then remove all newlines.
-    std::string messageText((std::istreambuf_iterator<char>(message)),
-                            std::istreambuf_iterator<char>());
-    std::transform(messageText.begin(), messageText.end(), messageText.begin(), [](unsigned char c)
-    { return std::tolower(c); });
-    std::replace(messageText.begin(), messageText.end(), '\n', ' ');
-    // go over pairs and calculate the score of the message
-    for (auto const &p: map)
-    {
-        std::string toFind = p.first;
-        std::transform(toFind.begin(), toFind.end(), toFind.begin(), [](unsigned char c)
-        { return std::tolower(c); });
-        size_t step = toFind.size();
-        size_t pos = 0, count = 0;
-        while ((pos = messageText.find(toFind, pos)) != std::string::npos)
-        {
-            pos += step;
-            ++count;
-        }
-        score += count * p.second;
+    scanner.begin();
+    while (message.read(&chunk[0], READ_SIZE) || message.gcount() > 0)
+    {
+        chunk.resize((size_t) message.gcount());
+        normalizeMessage(chunk);
+        // match all the phrases in a single pass over the message
+        score += scanner.feedScore(chunk);
     }
     return score;
 }
@@ -140,18 +265,578 @@ bool isEmpty(std::ifstream &file)
 }
 
 /**
- * Main driver of the program.
+ * Compiles a database file to a table file, which later runs map instead of parsing the database.
+ * @param databasePath path of the database file
+ * @param tablePath path of the table file to write
+ * @return EXIT_FAILURE in cases of invalid database, or memory error; EXIT_SUCCESS otherwise.
+ */
+int compileDatabase(const char *databasePath, const char *tablePath)
+{
+    std::ifstream database(databasePath);
+    if (database.fail())
+    {
+        std::cerr << "Invalid input" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::vector<std::string> phrases;
+    std::vector<int> scores;
+    try
+    {
+        parseDatabase(database, phrases, scores);
+        database.close();
+        HashMap<std::string, int> map(std::move(phrases), std::move(scores));
+        map.serialize(tablePath);
+    }
+    catch (std::bad_alloc &e)
+    {
+        std::cerr << "Memory allocation failed." << std::endl;
+        return EXIT_FAILURE;
+    }
+    catch (std::invalid_argument &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// ====================================== SERVE MODE =============================================
+
+/**
+ * A client of the serve mode, reading framed messages from a file descriptor, and writing their
+ * verdicts to another. Both directions are buffered; the verdicts are flushed only when the
+ * buffered input is exhausted, so a client pipelining messages gets its verdicts in batches, and
+ * a client waiting for each verdict gets it at once.
+ */
+class Connection
+{
+    int _in;
+    int _out;
+    std::string _input; // buffered input, from _start
+    size_t _start;
+    std::string _output; // verdicts not written yet
+    bool _ended; // the input ended, or could not be read
+    bool _failed; // the output could not be written
+
+    /**
+     * Flushes the output, then reads more input, blocking until some arrives.
+     * @return true if input was read; false on end of input or error.
+     */
+    bool _fill()
+    {
+        if (!flush())
+        {
+            return false;
+        }
+        _input.erase(0, _start);
+        _start = 0;
+        size_t size = _input.size();
+        _input.resize(size + READ_SIZE);
+        ssize_t n;
+        do
+        {
+            n = ::read(_in, &_input[size], READ_SIZE);
+        } while (n == -1 && errno == EINTR);
+        _input.resize(size + (n > 0 ? (size_t) n : 0));
+        _ended = n <= 0;
+        return n > 0;
+    }
+
+public:
+    /**
+     * Constructor of a connection.
+     * @param in file descriptor of the framed messages
+     * @param out file descriptor of the verdicts, possibly in
+     */
+    Connection(int in, int out) : _in(in), _out(out), _start(0), _ended(false), _failed(false)
+    {}
+
+    /**
+     * Reads a line, without its line ending. A line which is too long, or cut by the end of the
+     * input, is left unread.
+     * @param line output - the line
+     * @param maxLength maximal length of a line
+     * @return true if a line was read; false on end of input, or on a line longer than maxLength,
+     * or ending without a line ending (see ended()).
+     */
+    bool readLine(std::string &line, size_t maxLength)
+    {
+        size_t end;
+        while ((end = _input.find('\n', _start)) == std::string::npos)
+        {
+            // one more byte for a '\r' before the '\n'
+            if (_input.size() - _start > maxLength + 1 || !_fill())
+            {
+                return false;
+            }
+        }
+        size_t length = end > _start && _input[end - 1] == '\r' ? end - 1 - _start : end - _start;
+        if (length > maxLength)
+        {
+            return false;
+        }
+        line.assign(_input, _start, length);
+        _start = end + 1;
+        return true;
+    }
+
+    /**
+     * Reads a given number of bytes.
+     * @param length number of bytes
+     * @param data output - the bytes
+     * @return true if all the bytes were read; false if the input ended before.
+     */
+    bool read(size_t length, std::string &data)
+    {
+        while (_input.size() - _start < length)
+        {
+            if (!_fill())
+            {
+                return false;
+            }
+        }
+        data.assign(_input, _start, length);
+        _start += length;
+        return true;
+    }
+
+    /**
+     * @return true if the input ended, or could not be read, and was read up to its end.
+     */
+    bool ended() const
+    { return _ended && _start == _input.size(); }
+
+    /**
+     * Buffers data to be written.
+     * @param data data
+     */
+    void write(const std::string &data)
+    {
+        _output += data;
+    }
+
+    /**
+     * Writes the buffered data.
+     * @return true if all of it was written; false otherwise.
+     */
+    bool flush()
+    {
+        size_t written = 0;
+        while (!_failed && written < _output.size())
+        {
+            ssize_t n = ::write(_out, _output.data() + written, _output.size() - written);
+            if (n > 0)
+            {
+                written += (size_t) n;
+            }
+            else if (n == -1 && errno != EINTR)
+            {
+                _failed = true;
+            }
+        }
+        _output.clear();
+        return !_failed;
+    }
+};
+
+/**
+ * Scores the messages of a client, until it closes its input. Every message is framed as its
+ * length in bytes, in decimal, on a line of its own, followed by the message itself; the verdict
+ * of every message is a line "SPAM <score>" or "NOT_SPAM <score>". An invalid frame is answered by
+ * "ERROR Invalid frame", and ends the connection.
+ * @param connection connection of the client
+ * @param scanner scanner of the automaton of the phrases of the database
+ * @param threshold threshold of spam
+ * @return true if every frame was valid and every verdict written; false otherwise.
+ */
+bool serveConnection(Connection &connection, AhoCorasick::Scanner &scanner, int threshold)
+{
+    std::string header;
+    std::string chunk;
+    while (connection.readLine(header, MAX_HEADER_LENGTH))
+    {
+        int length = header.empty() || header.size() > MAX_LENGTH_DIGITS ? -1 : checkNumber(header);
+        int score = 0;
+        scanner.begin();
+        // a long message is scanned chunk by chunk, not buffered whole
+        while (length > 0 && connection.read(std::min((size_t) length, (size_t) READ_SIZE), chunk))
+        {
+            length -= (int) chunk.size();
+            normalizeMessage(chunk);
+            score += scanner.feedScore(chunk);
+        }
+        if (length != 0)
+        {
+            connection.write("ERROR Invalid frame\n");
+            connection.flush();
+            return false;
+        }
+        std::string verdict = threshold <= score ? "SPAM " : "NOT_SPAM ";
+        connection.write(verdict + std::to_string(score) + "\n");
+    }
+    if (!connection.ended()) // a header too long, or cut by the end of the input
+    {
+        connection.write("ERROR Invalid frame\n");
+        connection.flush();
+        return false;
+    }
+    return connection.flush();
+}
+
+/**
+ * Set by SIGINT and SIGTERM to stop serving a socket.
+ */
+volatile std::sig_atomic_t stopServing = 0;
+
+/**
+ * Write end of the pipe waking serveSocket, or -1.
+ */
+int wakeServing = -1;
+
+/**
+ * Handler of SIGINT and SIGTERM while serving a socket: sets stopServing, and wakes serveSocket,
+ * which may be about to wait, so the signal is never missed.
+ */
+void requestStop(int)
+{
+    int savedErrno = errno;
+    stopServing = 1;
+    ssize_t written = ::write(wakeServing, "", 1); // a full pipe already wakes serveSocket
+    (void) written;
+    errno = savedErrno;
+}
+
+/**
+ * Serves clients of a Unix domain socket on a ThreadPool of SERVE_WORKERS workers, every one with
+ * a Scanner of its own, until SIGINT or SIGTERM, or until accepting a client fails. At most one
+ * client per worker is accepted at a time; the others wait in the listen backlog. The signals are
+ * blocked in the workers, and the main thread waits for both a free worker and a client in one
+ * poll, woken by a pipe when a signal arrives or a worker is freed. On exit, the input of the
+ * clients being served is shut down, so their frames already received are answered and the workers
+ * joined, however idle the clients. A socket file left at the path by a previous run is replaced.
+ * @param socketPath path of the socket
+ * @param matcher automaton of the phrases of the database, shared by the workers
+ * @param threshold threshold of spam
+ * @return EXIT_SUCCESS if stopped by a signal; EXIT_FAILURE otherwise.
+ */
+int serveSocket(const std::string &socketPath, const AhoCorasick &matcher, int threshold)
+{
+    std::signal(SIGPIPE, SIG_IGN); // a client which leaves early only ends its own connection
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    struct stat status{};
+    if (socketPath.size() >= sizeof(address.sun_path) ||
+        (::lstat(socketPath.c_str(), &status) == 0 && !S_ISSOCK(status.st_mode)))
+    {
+        std::cerr << "Invalid socket path" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+    ::unlink(socketPath.c_str());
+    int wake[2];
+    if (::pipe2(wake, O_NONBLOCK | O_CLOEXEC) == -1)
+    {
+        std::cerr << "Socket error: " << std::strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+    wakeServing = wake[1];
+    struct sigaction stop{};
+    stop.sa_handler = requestStop;
+    sigemptyset(&stop.sa_mask);
+    ::sigaction(SIGINT, &stop, nullptr);
+    ::sigaction(SIGTERM, &stop, nullptr);
+    int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener == -1 || ::bind(listener, (sockaddr *) &address, sizeof(address)) == -1 ||
+        ::listen(listener, SOCKET_BACKLOG) == -1)
+    {
+        std::cerr << "Socket error: " << std::strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::mutex lock;
+    std::vector<int> clients; // clients accepted and not finished
+    int result = EXIT_SUCCESS;
+    std::vector<AhoCorasick::Scanner> scanners(SERVE_WORKERS, AhoCorasick::Scanner(matcher));
+    sigset_t stopSignals;
+    sigset_t previousMask;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    // the workers inherit the mask, so the signals are only delivered to this thread
+    ::pthread_sigmask(SIG_BLOCK, &stopSignals, &previousMask);
+    {
+        ThreadPool pool(SERVE_WORKERS);
+        ::pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+        while (!stopServing)
+        {
+            bool full;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                full = clients.size() >= pool.threadCount();
+            }
+            pollfd events[2] = {{wake[0], POLLIN, 0}, {listener, (short) (full ? 0 : POLLIN), 0}};
+            if (::poll(events, 2, -1) == -1)
+            {
+                continue; // EINTR, a signal
+            }
+            char drained[64];
+            while (::read(wake[0], drained, sizeof(drained)) > 0)
+            {
+            }
+            if (stopServing || !(events[1].revents & POLLIN))
+            {
+                continue;
+            }
+            int client = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client == -1)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                {
+                    continue;
+                }
+                std::cerr << "Socket error: " << std::strerror(errno) << std::endl;
+                result = EXIT_FAILURE;
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                clients.push_back(client);
+            }
+            pool.submit([client, threshold, &scanners, &lock, &clients, &wake](size_t worker)
+                        {
+                            Connection connection(client, client);
+                            serveConnection(connection, scanners[worker], threshold);
+                            {
+                                // forgotten before closed, so a reused descriptor is not shut
+                                std::lock_guard<std::mutex> guard(lock);
+                                clients.erase(std::find(clients.begin(), clients.end(), client));
+                            }
+                            ::close(client);
+                            ssize_t written = ::write(wake[1], "", 1); // a worker is free
+                            (void) written;
+                        });
+        }
+        ::close(listener);
+        ::unlink(socketPath.c_str());
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (int client : clients)
+            {
+                ::shutdown(client, SHUT_RD);
+            }
+        }
+    } // the pool finishes the clients being served, and joins its workers
+    wakeServing = -1;
+    ::close(wake[0]);
+    ::close(wake[1]);
+    return result;
+}
+
+/**
+ * Serve mode: loads the database once, then scores the messages of clients, see serveConnection;
+ * the client is the standard input and output, or every client of a Unix domain socket.
+ * @param databasePath path of the database, or of a table file compiled from it
+ * @param thresholdArgument threshold of spam
+ * @param socketPath path of the socket, nullptr for the standard input and output
+ * @return EXIT_FAILURE in cases of invalid arguments, invalid frames, or memory error;
+ * EXIT_SUCCESS otherwise.
+ */
+int serve(const char *databasePath, const char *thresholdArgument, const char *socketPath)
+{
+    std::ifstream database(databasePath);
+    int threshold = checkNumber(thresholdArgument);
+    if (database.fail() || threshold <= 0)
+    {
+        std::cerr << "Invalid input" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::shared_ptr<const AhoCorasick> matcher = loadSharedDatabase(database, databasePath);
+    if (matcher == nullptr)
+    {
+        return EXIT_FAILURE;
+    }
+    if (socketPath != nullptr)
+    {
+        return serveSocket(socketPath, *matcher, threshold);
+    }
+    Connection connection(STDIN_FILENO, STDOUT_FILENO);
+    AhoCorasick::Scanner scanner(*matcher);
+    return serveConnection(connection, scanner, threshold) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// ====================================== BATCH MODE =============================================
+
+/**
+ * Lists the message files of a batch.
+ * @param corpusPath a directory, whose regular files are listed sorted by path, or a manifest file,
+ * listing a path on every non empty line
+ * @param paths output - paths of the message files
+ * @return true if the directory or the manifest could be read; false otherwise.
+ */
+bool listMessages(const char *corpusPath, std::vector<std::string> &paths)
+{
+    try
+    {
+        if (std::filesystem::is_directory(corpusPath))
+        {
+            for (const auto &entry : std::filesystem::directory_iterator(corpusPath))
+            {
+                if (entry.is_regular_file())
+                {
+                    paths.push_back(entry.path().string());
+                }
+            }
+            std::sort(paths.begin(), paths.end());
+            return true;
+        }
+    }
+    catch (std::filesystem::filesystem_error &e)
+    {
+        return false;
+    }
+    std::ifstream manifest(corpusPath);
+    if (manifest.fail())
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (!line.empty())
+        {
+            paths.push_back(line);
+        }
+    }
+    return !manifest.bad();
+}
+
+/**
+ * Scores a message file.
+ * @param path path of the message file
+ * @param scanner scanner of the automaton of the phrases of the database
+ * @param threshold threshold of spam
+ * @return verdict of the message: "SPAM <score>", "NOT_SPAM <score>", or "ERROR <reason>".
+ */
+std::string scoreMessageFile(const std::string &path, AhoCorasick::Scanner &scanner, int threshold)
+{
+    try
+    {
+        std::ifstream message(path);
+        if (message.fail())
+        {
+            return "ERROR Invalid input";
+        }
+        int score = parseMessage(message, scanner);
+        return (threshold <= score ? "SPAM " : "NOT_SPAM ") + std::to_string(score);
+    }
+    catch (std::bad_alloc &e)
+    {
+        return "ERROR Memory allocation failed.";
+    }
+}
+
+/**
+ * Batch mode: loads the database once, then scores every message file of a directory or manifest
+ * on a ThreadPool, every worker with an AhoCorasick::Scanner of its own over the shared automaton.
+ * A line "<path> <verdict>" (see scoreMessageFile) is written for every file, in the order of the
+ * list, as soon as the files before it are scored.
+ * @param databasePath path of the database, or of a table file compiled from it
+ * @param thresholdArgument threshold of spam
+ * @param corpusPath directory or manifest of the message files, see listMessages
+ * @param threadsArgument number of threads, nullptr for one per hardware thread
+ * @return EXIT_FAILURE in cases of invalid arguments, memory error, or a message file which could
+ * not be scored; EXIT_SUCCESS otherwise.
+ */
+int batch(const char *databasePath, const char *thresholdArgument, const char *corpusPath,
+          const char *threadsArgument)
+{
+    std::ifstream database(databasePath);
+    int threshold = checkNumber(thresholdArgument);
+    std::string threadCount = threadsArgument != nullptr ? threadsArgument : "0";
+    int threads = threadCount.size() <= 4 ? checkNumber(threadCount) : -1;
+    std::vector<std::string> paths;
+    if (database.fail() || threshold <= 0 || threads < 0 || threads > MAX_THREADS ||
+        (threadsArgument != nullptr && threads == 0) || !listMessages(corpusPath, paths))
+    {
+        std::cerr << "Invalid input" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::shared_ptr<const AhoCorasick> matcher = loadSharedDatabase(database, databasePath);
+    if (matcher == nullptr)
+    {
+        return EXIT_FAILURE;
+    }
+    ThreadPool pool((size_t) threads);
+    std::vector<AhoCorasick::Scanner> scanners(pool.threadCount(), AhoCorasick::Scanner(*matcher));
+    std::vector<std::string> verdicts(paths.size());
+    std::vector<bool> scored(paths.size(), false);
+    std::mutex lock;
+    std::condition_variable ready;
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        pool.submit([&, i](size_t worker)
+                    {
+                        std::string verdict = scoreMessageFile(paths[i], scanners[worker],
+                                                               threshold);
+                        {
+                            std::lock_guard<std::mutex> guard(lock);
+                            verdicts[i] = std::move(verdict);
+                            scored[i] = true;
+                        }
+                        ready.notify_one();
+                    });
+    }
+    bool failed = false;
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        std::string verdict;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [&scored, i]()
+            { return scored[i]; });
+            verdict = std::move(verdicts[i]);
+        }
+        failed = failed || verdict.compare(0, 5, "ERROR") == 0;
+        std::cout << paths[i] << ' ' << verdict << '\n';
+    }
+    std::cout.flush();
+    pool.wait(); // the last task may still be notifying ready
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// SpamDetectorTester.cpp includes this file with SPAM_DETECTOR_NO_MAIN defined, to test its helpers
+#ifndef SPAM_DETECTOR_NO_MAIN
+
+/**
+ * Main driver of the program. The database is either a database file, or a table file compiled
+ * from one with --compile, which is mapped rather than parsed. With --serve, the database is loaded
+ * once to score a stream of messages, and with --batch, to score many message files in parallel.
  * @param argc number of arguments
  * @param argv arguments array
  * @return EXIT_FAILURE in cases of invalid arguments, or memory error; EXIT_SUCCESS otherwise.
  */
 int main(int argc, char *argv[])
 {
+    if (argc > 1 && std::string(argv[1]) == SERVE_FLAG && (argc == 4 || argc == 5))
+    {
+        return serve(argv[2], argv[3], argc == 5 ? argv[4] : nullptr);
+    }
+    if (argc > 1 && std::string(argv[1]) == BATCH_FLAG && (argc == 5 || argc == 6))
+    {
+        return batch(argv[2], argv[3], argv[4], argc == 6 ? argv[5] : nullptr);
+    }
     if (argc != 4)
     {
-        std::cerr << "Usage: SpamDetector <database path> <message path> <threshold>" << std::endl;
+        std::cerr << USAGE << std::endl;
         return EXIT_FAILURE;
     }
+    if (std::string(argv[1]) == COMPILE_FLAG)
+    {
+        return compileDatabase(argv[2], argv[3]);
+    }
     std::ifstream database(argv[1]);
     std::ifstream message(argv[2]);
     int threshold = checkNumber(argv[3]);
@@ -167,15 +852,12 @@ int main(int argc, char *argv[])
         std::cout << "NOT_SPAM" << std::endl;
         return EXIT_SUCCESS;
     }
-    std::vector<std::string> phrases;
-    std::vector<int> scores;
     int score = 0;
     try
     {
-        parseDatabase(database, phrases, scores);
-        database.close();
-        HashMap<std::string, int> map(phrases, scores);
-        score = parseMessage(message, map);
+        AhoCorasick matcher = loadDatabase(database, argv[1]);
+        AhoCorasick::Scanner scanner(matcher);
+        score = parseMessage(message, scanner);
         message.close();
     }
     catch (std::bad_alloc &e)
@@ -196,4 +878,6 @@ int main(int argc, char *argv[])
     threshold <= score ? std::cout << "SPAM" << std::endl : std::cout << "NOT_SPAM" << std::endl;
     return EXIT_SUCCESS;
 
-}
\ No newline at end of file
+}
+
+#endif //SPAM_DETECTOR_NO_MAIN
\ No newline at end of file
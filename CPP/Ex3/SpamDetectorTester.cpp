@@ -0,0 +1,328 @@
+// Tests of the phrase matching of SpamDetector: the Aho-Corasick automaton, feeding it in chunks,
+// and the normalization kernel, all against the original find loop over a whole message, and of
+// the frames of the serve mode. The
+// kernel is chosen at compile time, so build and run the tester once per kernel:
+//     g++ -std=c++17 -pthread SpamDetectorTester.cpp -o tester && ./tester             (SSE2)
+//     g++ -std=c++17 -pthread -mavx2 SpamDetectorTester.cpp -o tester && ./tester      (AVX2)
+//     g++ -std=c++17 -pthread -mno-sse2 SpamDetectorTester.cpp -o tester && ./tester   (scalar)
+// Every build checks itself against the same reference, and prints a checksum of its scores, which
+// must be equal across builds.
+
+#define SPAM_DETECTOR_NO_MAIN
+#include "SpamDetector.cpp"
+#include <cassert>
+#include <random>
+
+/**
+ * Sum of all the scores computed by the tests, to compare builds.
+ */
+unsigned long checksum = 0;
+
+/**
+ * Normalizes a message the way SpamDetector always did, one byte at a time: lower case, and
+ * newlines (and since the SIMD kernel, tabs) replaced by spaces.
+ * @param text message
+ * @return the normalized message
+ */
+std::string referenceNormalize(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c)
+    { return std::tolower(c); });
+    std::replace(text.begin(), text.end(), '\n', ' ');
+    std::replace(text.begin(), text.end(), '\t', ' ');
+    return text;
+}
+
+/**
+ * Scores a whole message with the original find loop: every phrase is searched on its own, and its
+ * occurrences counted without overlapping each other.
+ * @param text message
+ * @param phrases phrases and their scores
+ * @return score of the message
+ */
+int referenceScore(const std::string &text, const HashMap<std::string, int> &phrases)
+{
+    std::string messageText = referenceNormalize(text);
+    int score = 0;
+    for (auto const &p : phrases)
+    {
+        std::string toFind = referenceNormalize(p.first);
+        if (toFind.empty()) // would be found forever
+        {
+            continue;
+        }
+        size_t pos = 0;
+        while ((pos = messageText.find(toFind, pos)) != std::string::npos)
+        {
+            pos += toFind.size();
+            score += p.second;
+        }
+    }
+    return score;
+}
+
+/**
+ * Scores a message like SpamDetector, streaming it through parseMessage in chunks of READ_SIZE.
+ * @param text message
+ * @param scanner scanner of the automaton of the phrases
+ * @return score of the message
+ */
+int streamedScore(const std::string &text, AhoCorasick::Scanner &scanner)
+{
+    std::istringstream message(text);
+    int score = parseMessage(message, scanner);
+    checksum += (unsigned long) score;
+    return score;
+}
+
+/**
+ * @param random random generator
+ * @param alphabet bytes to draw from
+ * @param length length of the string
+ * @return a random string of the bytes of alphabet.
+ */
+std::string randomString(std::mt19937 &random, const std::string &alphabet, size_t length)
+{
+    std::string s(length, ' ');
+    for (char &c : s)
+    {
+        c = alphabet[random() % alphabet.size()];
+    }
+    return s;
+}
+
+void testNormalization()
+{
+    std::mt19937 random(1);
+    std::string everyByte(256, '\0');
+    for (int b = 0; b < 256; ++b)
+    {
+        everyByte[b] = (char) b;
+    }
+    // every offset and length, so every byte goes through both the vector loop and the tail
+    for (size_t first = 0; first < 64; ++first)
+    {
+        for (size_t length = 0; first + length <= everyByte.size(); length += 7)
+        {
+            std::string chunk = everyByte.substr(first, length);
+            std::string expected = referenceNormalize(chunk);
+            normalizeMessage(chunk);
+            assert(chunk == expected);
+        }
+    }
+    for (int round = 0; round < 10000; ++round)
+    {
+        std::string chunk = randomString(random, everyByte, random() % 300);
+        std::string expected = referenceNormalize(chunk);
+        normalizeMessage(chunk);
+        assert(chunk == expected);
+    }
+    std::string crlf = "Buy\r\nNOW\t\r";
+    normalizeMessage(crlf);
+    assert(crlf == "buy\r now \r"); // carriage returns are kept
+    std::cout << "passed test Normalization\n";
+}
+
+void testTabsAndCarriageReturns()
+{
+    HashMap<std::string, int> phrases;
+    phrases.insert("buy now", 10);
+    phrases.insert("free\r", 3);
+    phrases.insert("get\tPaid", 4);
+    AhoCorasick matcher(phrases);
+    AhoCorasick::Scanner scanner(matcher);
+    assert(streamedScore("BUY\tNOW", scanner) == 10);
+    assert(streamedScore("buy\nnow, Buy Now", scanner) == 20);
+    assert(streamedScore("buy\r\nnow", scanner) == 0); // "buy\r now"
+    assert(streamedScore("FREE\r\nfree\rfree", scanner) == 6);
+    assert(streamedScore("please GET\tpaid", scanner) == 4); // phrases are normalized too
+    assert(streamedScore("get paid, get\npaid", scanner) == 8);
+    assert(streamedScore("", scanner) == 0);
+    std::cout << "passed test TabsAndCarriageReturns\n";
+}
+
+void testMatcherAgainstFindLoop()
+{
+    std::mt19937 random(2);
+    for (int round = 0; round < 3000; ++round)
+    {
+        HashMap<std::string, int> phrases;
+        int count = 1 + (int) (random() % 20);
+        for (int i = 0; i < count; ++i)
+        {
+            std::string phrase = randomString(random, "abAB c\t\n", 1 + random() % 5);
+            phrases[phrase] = 1 + (int) (random() % 9);
+        }
+        AhoCorasick matcher(phrases);
+        AhoCorasick::Scanner scanner(matcher);
+        std::string text = randomString(random, "abAB c\n\t\r", random() % 400);
+        assert(streamedScore(text, scanner) == referenceScore(text, phrases));
+        assert(matcher.score(referenceNormalize(text)) == referenceScore(text, phrases));
+    }
+    std::cout << "passed test MatcherAgainstFindLoop\n";
+}
+
+void testSparseAutomaton()
+{
+    std::mt19937 random(3);
+    std::string alphabet;
+    for (int b = 0x21; b < 0xFF; ++b)
+    {
+        alphabet += (char) b;
+    }
+    alphabet += "\t\n";
+    HashMap<std::string, int> phrases;
+    std::vector<std::string> list;
+    for (int i = 0; i < 3000; ++i)
+    {
+        list.push_back(randomString(random, alphabet, 10 + random() % 20));
+        phrases[list.back()] = 1 + (int) (random() % 9);
+    }
+    AhoCorasick matcher(phrases);
+    assert(!matcher.isDense()); // too many states times classes for the complete DFA
+    AhoCorasick::Scanner scanner(matcher);
+    for (int round = 0; round < 20; ++round)
+    {
+        std::string text = randomString(random, alphabet, 3000);
+        for (int i = 0; i < 30; ++i)
+        {
+            text.insert(random() % text.size(), list[random() % list.size()]);
+        }
+        assert(streamedScore(text, scanner) == referenceScore(text, phrases));
+    }
+    std::cout << "passed test SparseAutomaton\n";
+}
+
+void testChunkedFeeding()
+{
+    std::mt19937 random(4);
+    for (int round = 0; round < 2000; ++round)
+    {
+        HashMap<std::string, int> phrases;
+        int count = 1 + (int) (random() % 20);
+        for (int i = 0; i < count; ++i)
+        {
+            phrases[randomString(random, "ab c\t\n", 1 + random() % 5)] = 1 + (int) (random() % 9);
+        }
+        AhoCorasick matcher(phrases);
+        AhoCorasick::Scanner scanner(matcher);
+        std::string text = randomString(random, "ab c", random() % 300);
+        std::vector<std::pair<int, size_t>> whole;
+        std::vector<std::pair<int, size_t>> chunked;
+        matcher.scan(text, [&whole](int p, size_t start)
+        { whole.emplace_back(p, start); });
+        scanner.begin();
+        for (size_t i = 0; i < text.size();)
+        {
+            size_t length = std::min(text.size() - i, (size_t) (random() % 7));
+            scanner.feed(std::string_view(text).substr(i, length), [&chunked](int p, size_t start)
+            { chunked.emplace_back(p, start); });
+            i += length;
+        }
+        assert(whole == chunked);
+    }
+    std::cout << "passed test ChunkedFeeding\n";
+}
+
+void testPhrasesAcrossChunkBoundaries()
+{
+    std::mt19937 random(5);
+    HashMap<std::string, int> phrases;
+    phrases.insert("financial help", 5);
+    phrases.insert("buy now", 7);
+    phrases.insert("aaaa", 1);
+    AhoCorasick matcher(phrases);
+    AhoCorasick::Scanner scanner(matcher);
+    const std::string variants[] = {"FINANCIAL\nHelp", "financial\thelp", "Buy Now", "BUY\nnow",
+                                    "aaaaaaaaa"};
+    for (const std::string &phrase : variants)
+    {
+        // every position of the phrase around the boundaries of the first two chunks
+        for (size_t boundary : {(size_t) READ_SIZE, (size_t) 2 * READ_SIZE})
+        {
+            for (size_t offset = 0; offset <= phrase.size(); ++offset)
+            {
+                std::string text = randomString(random, "xyz ", 2 * READ_SIZE + 100);
+                text.replace(boundary - offset, phrase.size(), phrase);
+                int expected = referenceScore(text, phrases);
+                assert(expected > 0);
+                assert(streamedScore(text, scanner) == expected);
+            }
+        }
+    }
+    std::string large = randomString(random, "abAB c\n\t\r", 5 * READ_SIZE + 17);
+    assert(streamedScore(large, scanner) == referenceScore(large, phrases));
+    std::cout << "passed test PhrasesAcrossChunkBoundaries\n";
+}
+
+/**
+ * Serves a client sending the given bytes, through pipes.
+ * @param input bytes sent by the client, at most the capacity of a pipe
+ * @param scanner scanner of the automaton of the phrases
+ * @param served output - the result of serveConnection
+ * @return the bytes answered to the client.
+ */
+std::string serveFrames(const std::string &input, AhoCorasick::Scanner &scanner, bool &served)
+{
+    int in[2];
+    int out[2];
+    assert(::pipe(in) == 0 && ::pipe(out) == 0);
+    assert(::write(in[1], input.data(), input.size()) == (ssize_t) input.size());
+    ::close(in[1]);
+    Connection connection(in[0], out[1]);
+    served = serveConnection(connection, scanner, 10);
+    ::close(in[0]);
+    ::close(out[1]);
+    std::string answer;
+    char buffer[256];
+    ssize_t n;
+    while ((n = ::read(out[0], buffer, sizeof(buffer))) > 0)
+    {
+        answer.append(buffer, (size_t) n);
+    }
+    ::close(out[0]);
+    return answer;
+}
+
+void testFrames()
+{
+    HashMap<std::string, int> phrases;
+    phrases.insert("buy now", 10);
+    AhoCorasick matcher(phrases);
+    AhoCorasick::Scanner scanner(matcher);
+    bool served;
+    assert(serveFrames("", scanner, served).empty() && served);
+    assert(serveFrames("0\n", scanner, served) == "NOT_SPAM 0\n" && served);
+    assert(serveFrames("7\nBuy now3\r\nbuy", scanner, served) == "SPAM 10\nNOT_SPAM 0\n" && served);
+    const std::pair<std::string, std::string> invalid[] = {
+            {"123456789012345678901234567890123456789\nx", ""}, {"12", ""}, {"7\nbuy", ""},
+            {"x\nbuy", ""}, {"\n", ""}, {"3\nbuy12", "NOT_SPAM 0\n"}};
+    for (const auto &frames : invalid)
+    {
+        std::string answer = serveFrames(frames.first, scanner, served);
+        assert(answer == frames.second + "ERROR Invalid frame\n");
+        assert(!served);
+    }
+    std::cout << "passed test Frames\n";
+}
+
+int main()
+{
+#if defined(__AVX2__)
+    std::cout << "normalization kernel: AVX2\n";
+#elif defined(__SSE2__)
+    std::cout << "normalization kernel: SSE2\n";
+#else
+    std::cout << "normalization kernel: scalar\n";
+#endif
+    testNormalization();
+    testTabsAndCarriageReturns();
+    testMatcherAgainstFindLoop();
+    testSparseAutomaton();
+    testChunkedFeeding();
+    testPhrasesAcrossChunkBoundaries();
+    testFrames();
+    std::cout << "scores checksum: " << checksum << "\n";
+    std::cout << "good job!! you passed all tests!\n";
+    return EXIT_SUCCESS;
+}
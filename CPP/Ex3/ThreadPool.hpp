@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+#ifndef EX3_THREADPOOL_H
+#define EX3_THREADPOOL_H
+
+/**
+ * A fixed pool of worker threads running tasks, with work stealing: every worker owns a deque of
+ * tasks, runs its own tasks newest first, and when it has none steals the oldest task of another
+ * worker, so workers given long tasks do not hold back the others.
+ * A task is called with the index of the worker running it, in [0, threadCount()), so tasks can
+ * share per worker scratch state (e.g. one AhoCorasick::Scanner per worker) without locking it.
+ * Tasks must not throw; a task may submit more tasks, which go to the deque of its own worker.
+ */
+class ThreadPool
+{
+public:
+    using task = std::function<void(size_t worker)>;
+
+private:
+    /**
+     * Deque of tasks of a worker, locked by its owner and by thieves.
+     */
+    struct _Worker
+    {
+        std::mutex lock;
+        std::deque<task> tasks;
+    };
+
+    std::vector<std::unique_ptr<_Worker>> _workers;
+    std::vector<std::thread> _threads;
+    std::mutex _lock; // guards _pending, _stopping and the waits on them
+    std::condition_variable _wake; // workers: a task was queued, or the pool is stopping
+    std::condition_variable _idle; // wait(): every task has finished
+    std::atomic<size_t> _queued; // tasks in the deques; never below their actual number when read
+    size_t _pending; // tasks submitted and not finished
+    size_t _nextWorker; // deque of the next task submitted from outside the pool
+    bool _stopping;
+
+// ================================ PRIVATE HELPER METHODS =======================================
+
+    /**
+     * @return the pool of the calling thread and its worker index, or nullptr if it is not a
+     * worker.
+     */
+    static std::pair<const ThreadPool *, size_t> &_current()
+    {
+        static thread_local std::pair<const ThreadPool *, size_t> current(nullptr, 0);
+        return current;
+    }
+
+    /**
+     * Takes a task: the newest of the worker's own deque, else the oldest of another worker's.
+     * @param self index of the worker
+     * @param t output - the task
+     * @return true if a task was taken; false if every deque was empty.
+     */
+    bool _take(size_t self, task &t)
+    {
+        for (size_t i = 0; i < _workers.size(); ++i)
+        {
+            _Worker &worker = *_workers[(self + i) % _workers.size()];
+            std::lock_guard<std::mutex> guard(worker.lock);
+            if (!worker.tasks.empty())
+            {
+                if (i == 0)
+                {
+                    t = std::move(worker.tasks.back());
+                    worker.tasks.pop_back();
+                }
+                else
+                {
+                    t = std::move(worker.tasks.front());
+                    worker.tasks.pop_front();
+                }
+                _queued.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Main loop of a worker: runs tasks until the pool is stopping and no task is left.
+     * @param self index of the worker
+     */
+    void _run(size_t self)
+    {
+        _current() = {this, self};
+        task t;
+        while (true)
+        {
+            if (_take(self, t))
+            {
+                t(self);
+                t = nullptr;
+                std::lock_guard<std::mutex> guard(_lock);
+                if (--_pending == 0)
+                {
+                    _idle.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(_lock);
+            _wake.wait(guard, [this]()
+            { return _stopping || _queued.load() > 0; });
+            if (_stopping && _queued.load() == 0)
+            {
+                return;
+            }
+        }
+    }
+
+public:
+
+// ================================= CTORS, DTOR & RULE OF 5 =====================================
+
+    /**
+     * Constructor, starts the workers.
+     * @param threadCount number of workers; 0 for one per hardware thread
+     */
+    explicit ThreadPool(size_t threadCount = 0) : _queued(0), _pending(0), _nextWorker(0),
+                                                  _stopping(false)
+    {
+        if (threadCount == 0)
+        {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            _workers.push_back(std::make_unique<_Worker>());
+        }
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            _threads.emplace_back(&ThreadPool::_run, this, i);
+        }
+    }
+
+    /**
+     * A pool can't be copied.
+     */
+    ThreadPool(const ThreadPool &other) = delete;
+
+    /**
+     * A pool can't be copied.
+     */
+    ThreadPool &operator=(const ThreadPool &other) = delete;
+
+    /**
+     * Destructor, runs the tasks left, then joins the workers.
+     */
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _stopping = true;
+        }
+        _wake.notify_all();
+        for (std::thread &thread : _threads)
+        {
+            thread.join();
+        }
+    }
+
+// ======================================= API METHODS ===========================================
+
+    /**
+     * @return number of workers.
+     */
+    size_t threadCount() const
+    { return _workers.size(); }
+
+    /**
+     * Queues a task: on the calling worker's deque if called from a task of this pool, else on the
+     * workers' deques in turn.
+     * @param t task, called as t(size_t worker)
+     */
+    void submit(task t)
+    {
+        std::pair<const ThreadPool *, size_t> current = _current();
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            size_t self = current.first == this ? current.second : _nextWorker++ % _workers.size();
+            {
+                std::lock_guard<std::mutex> workerGuard(_workers[self]->lock);
+                _workers[self]->tasks.push_back(std::move(t));
+            }
+            // counted while _lock is held, so a worker checking _queued under it sees the task
+            _queued.fetch_add(1);
+            ++_pending;
+        }
+        _wake.notify_one();
+    }
+
+    /**
+     * Blocks until every task submitted has finished. Must not be called from a task.
+     */
+    void wait()
+    {
+        std::unique_lock<std::mutex> guard(_lock);
+        _idle.wait(guard, [this]()
+        { return _pending == 0; });
+    }
+};
+
+
+#endif //EX3_THREADPOOL_H